@@ -0,0 +1,237 @@
+#include "alloc_profile.h"
+#include <algorithm>
+#include <iterator>
+#include <mutex>
+#include <sys/resource.h>
+
+#ifdef ID3_ALLOC_PROFILE
+#include <cstdlib>
+#include <malloc.h>
+#include <new>
+#endif
+
+namespace {
+
+// Profile of one thread, its mutex is only contended while a report is taken
+struct ThreadProfile {
+    std::mutex mutex;
+    AllocProfile profile;
+};
+
+// Profiles of running threads and what threads that have exited left behind
+std::mutex registry_mutex;
+std::vector<ThreadProfile*> registry;
+AllocProfile finished;
+
+void MergeProfile(AllocProfile& profile, AllocProfile&& other) {
+    profile.files.insert(profile.files.end(), std::make_move_iterator(other.files.begin()),
+                         std::make_move_iterator(other.files.end()));
+    for (const auto& [frame_id, stats] : other.frames) {
+        profile.frames[frame_id].Merge(stats);
+    }
+    other = AllocProfile();
+}
+
+#ifdef ID3_ALLOC_PROFILE
+
+class ThreadProfileOwner {
+public:
+    ThreadProfileOwner() {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        registry.push_back(&data);
+    }
+
+    ~ThreadProfileOwner() {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        registry.erase(std::find(registry.begin(), registry.end(), &data));
+        MergeProfile(finished, std::move(data.profile));
+    }
+
+    ThreadProfile data;
+};
+
+ThreadProfile& LocalProfile() {
+    thread_local ThreadProfileOwner owner;
+    return owner.data;
+}
+
+thread_local AllocCounter* file_counter = nullptr;
+thread_local AllocCounter* frame_counter = nullptr;
+// Set while the profiler itself allocates, those allocations aren't counted
+thread_local bool busy = false;
+
+void Count(AllocCounter* counter, int64_t size) {
+    if (counter == nullptr) {
+        return;
+    }
+    if (size > 0) {
+        ++counter->allocations;
+        counter->bytes += size;
+    }
+    counter->live += size;
+    counter->peak = std::max(counter->peak, counter->live);
+}
+
+// Usable size is what the block really holds, so frees match allocations exactly
+void CountAllocation(void* ptr) {
+    if (!busy && ptr != nullptr) {
+        int64_t size = malloc_usable_size(ptr);
+        Count(file_counter, size);
+        for (AllocCounter* counter = frame_counter; counter != nullptr; counter = counter->outer) {
+            Count(counter, size);
+        }
+    }
+}
+
+void CountFree(void* ptr) {
+    if (!busy && ptr != nullptr) {
+        int64_t size = malloc_usable_size(ptr);
+        Count(file_counter, -size);
+        for (AllocCounter* counter = frame_counter; counter != nullptr; counter = counter->outer) {
+            Count(counter, -size);
+        }
+    }
+}
+
+AllocStats ToStats(const AllocCounter& counter) {
+    AllocStats stats;
+    stats.allocations = counter.allocations;
+    stats.bytes = counter.bytes;
+    stats.peak = counter.peak;
+    return stats;
+}
+
+void* Allocate(size_t size) {
+    void* ptr = std::malloc(size == 0 ? 1 : size);
+    CountAllocation(ptr);
+    return ptr;
+}
+
+void Free(void* ptr) {
+    CountFree(ptr);
+    std::free(ptr);
+}
+
+#endif
+
+}  // namespace
+
+#ifdef ID3_ALLOC_PROFILE
+
+FileAllocScope::FileAllocScope(const std::string& file) : file(file), outer(file_counter) {
+    file_counter = &counter;
+}
+
+FileAllocScope::~FileAllocScope() {
+    file_counter = outer;
+    busy = true;
+    {
+        ThreadProfile& local = LocalProfile();
+        std::lock_guard<std::mutex> lock(local.mutex);
+        local.profile.files.emplace_back(file, ToStats(counter));
+    }
+    busy = false;
+}
+
+FrameAllocScope::FrameAllocScope(const std::string& frame_id) : frame_id(frame_id) {
+    counter.outer = frame_counter;
+    frame_counter = &counter;
+}
+
+FrameAllocScope::~FrameAllocScope() {
+    frame_counter = counter.outer;
+    busy = true;
+    {
+        ThreadProfile& local = LocalProfile();
+        std::lock_guard<std::mutex> lock(local.mutex);
+        local.profile.frames[frame_id].Merge(ToStats(counter));
+    }
+    busy = false;
+}
+
+void* operator new(size_t size) {
+    void* ptr = Allocate(size);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return Allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return Allocate(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    Free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    Free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    Free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    Free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+    Free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+    Free(ptr);
+}
+
+#endif
+
+AllocProfile TakeAllocProfile() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    AllocProfile result;
+    MergeProfile(result, std::move(finished));
+    for (ThreadProfile* thread : registry) {
+        std::lock_guard<std::mutex> thread_lock(thread->mutex);
+        MergeProfile(result, std::move(thread->profile));
+    }
+    return result;
+}
+
+void PrintAllocProfile(std::ostream& out, const AllocProfile& profile) {
+#ifndef ID3_ALLOC_PROFILE
+    out << "Allocation profiling is off, build with ID3_ALLOC_PROFILE\n";
+#endif
+
+    AllocStats total;
+    out << "Files (allocations, bytes, peak):\n";
+    for (const auto& [file, stats] : profile.files) {
+        out << '\t' << stats.allocations << '\t' << stats.bytes << '\t' << stats.peak << '\t' << file << '\n';
+        total.Merge(stats);
+    }
+
+    out << "Frames (allocations, bytes, peak):\n";
+    for (const auto& [frame_id, stats] : profile.frames) {
+        out << '\t' << stats.allocations << '\t' << stats.bytes << '\t' << stats.peak << '\t' << frame_id << '\n';
+    }
+
+    out << "Summary: " << profile.files.size() << " files, " << total.allocations << " allocations, "
+        << total.bytes << " bytes, peak per file " << total.peak << " bytes";
+    if (!profile.files.empty()) {
+        out << ", " << total.allocations / profile.files.size() << " allocations per file";
+    }
+
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        out << ", peak RSS " << usage.ru_maxrss << " KiB";
+    }
+    out << '\n';
+}
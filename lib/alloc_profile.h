@@ -0,0 +1,88 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Allocation profiling is compiled in with ID3_ALLOC_PROFILE (the ID3PARSE_ALLOC_PROFILE
+// CMake option). It replaces the global operator new/delete; scopes below are empty
+// and cost nothing in a regular build.
+
+struct AllocStats {
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+    // Highest amount of heap bytes allocated in the scope and still alive
+    uint64_t peak = 0;
+
+    void Merge(const AllocStats& other) {
+        allocations += other.allocations;
+        bytes += other.bytes;
+        peak = std::max(peak, other.peak);
+    }
+};
+
+struct AllocProfile {
+    std::vector<std::pair<std::string, AllocStats>> files;
+    std::map<std::string, AllocStats> frames;
+};
+
+#ifdef ID3_ALLOC_PROFILE
+
+// Counters of the running scope, only touched by the thread that owns them
+struct AllocCounter {
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+    int64_t live = 0;
+    int64_t peak = 0;
+    // Scope of the enclosing frame, which counts the allocations too
+    AllocCounter* outer = nullptr;
+};
+
+// Counts allocations of the current thread while parsing the file
+class FileAllocScope {
+public:
+    explicit FileAllocScope(const std::string& file);
+    ~FileAllocScope();
+
+private:
+    const std::string& file;
+    AllocCounter counter;
+    AllocCounter* outer;
+};
+
+// Counts allocations of the current thread while a frame is created, read, passed to
+// the callback and destroyed. Nested in FileAllocScope, allocations count for both;
+// sub-frames of CHAP and CTOC count for the enclosing frame as well.
+class FrameAllocScope {
+public:
+    explicit FrameAllocScope(const std::string& frame_id);
+    ~FrameAllocScope();
+
+private:
+    const std::string& frame_id;
+    AllocCounter counter;
+};
+
+#else
+
+class FileAllocScope {
+public:
+    explicit FileAllocScope(const std::string&) {}
+};
+
+class FrameAllocScope {
+public:
+    explicit FrameAllocScope(const std::string&) {}
+};
+
+#endif
+
+// Moves out everything collected so far by all threads. Every thread keeps its own
+// profile, they are only merged here.
+AllocProfile TakeAllocProfile();
+
+// Per file and per frame type lines, then the summary over the batch with peak RSS of the process
+void PrintAllocProfile(std::ostream& out, const AllocProfile& profile);
@@ -0,0 +1,196 @@
+#include "analytics.h"
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <thread>
+
+namespace {
+
+uint64_t SaturatingAdd(uint64_t lhs, uint64_t rhs) {
+    return lhs > UINT64_MAX - rhs ? UINT64_MAX : lhs + rhs;
+}
+
+void AddValues(GroupMap& groups, const std::vector<std::string>& values, uint64_t file_size) {
+    GroupStats file{1, file_size};
+    if (values.empty()) {
+        AddToGroup(groups, ANALYTICS_NONE, file);
+    }
+    for (const auto& value : values) {
+        AddToGroup(groups, value, file);
+    }
+}
+
+void MergeGroups(GroupMap& groups, const GroupMap& other) {
+    for (const auto& [key, stats] : other) {
+        AddToGroup(groups, key, stats);
+    }
+}
+
+void PrintGroups(std::ostream& out, const std::string& title, const GroupMap& groups, size_t top) {
+    std::vector<const GroupMap::value_type*> order;
+    order.reserve(groups.size());
+    for (const auto& group : groups) {
+        order.push_back(&group);
+    }
+
+    top = std::min(top, order.size());
+    std::partial_sort(order.begin(), order.begin() + top, order.end(), [](const auto* lhs, const auto* rhs) {
+        if (lhs->second.count != rhs->second.count) {
+            return lhs->second.count > rhs->second.count;
+        }
+        return lhs->first < rhs->first;
+    });
+
+    out << title << " (" << groups.size() << " groups):\n";
+    for (size_t i = 0; i < top; ++i) {
+        out << '\t' << order[i]->second.count << '\t' << order[i]->second.bytes << '\t' << order[i]->first << '\n';
+    }
+}
+
+}  // namespace
+
+void AddToGroup(GroupMap& groups, std::string_view key, const GroupStats& stats) {
+#if defined(__cpp_lib_generic_unordered_lookup)
+    auto it = groups.find(key);
+#else
+    // Unordered maps take other key types from C++20, until then a reused key keeps its capacity
+    thread_local std::string lookup_key;
+    lookup_key.assign(key.data(), key.size());
+    auto it = groups.find(lookup_key);
+#endif
+    if (it == groups.end()) {
+        if (groups.size() < ANALYTICS_MAX_GROUPS) {
+            it = groups.emplace(key, GroupStats()).first;
+        } else {
+            it = groups.try_emplace(ANALYTICS_OTHER).first;
+        }
+    }
+    it->second.Merge(stats);
+}
+
+ParseError LibraryStats::Add(const std::string& file) {
+    std::error_code code;
+    uint64_t file_size = std::filesystem::file_size(file, code);
+    if (code) {
+        file_size = 0;
+    }
+
+    // Frames are destroyed right after the callback, so values are copied
+    std::vector<std::string> genre;
+    std::vector<std::string> artist;
+    std::vector<std::string> album;
+
+    Header header;
+    ParseError error = ParseFrames(file, header, [&](Frame& frame) {
+        const std::string& id = frame.Id();
+        AddToGroup(frames, id, {1, frame.Size()});
+
+        int encoding = frame.Encoding();
+        if (encoding != NO_ENCODING && !frame.InFile()) {
+            encodings[std::min<size_t>(encoding, ANALYTICS_ENCODINGS - 1)].Add(frame.Size());
+        }
+
+        if (id == "TCON" || id == "TPE1" || id == "TALB") {
+            auto& values = id == "TCON" ? genre : (id == "TPE1" ? artist : album);
+            const auto& text = static_cast<const TextFrame&>(frame).Values();
+            values.insert(values.end(), text.begin(), text.end());
+        } else if (id == "POPM") {
+            const auto& popm = static_cast<const PopularimeterFrame&>(frame);
+            ++ratings[popm.Rating()];
+            popm_plays = SaturatingAdd(popm_plays, popm.Counter());
+        } else if (id == "PCNT") {
+            pcnt_plays = SaturatingAdd(pcnt_plays, static_cast<const PlayCounterFrame&>(frame).Counter());
+        }
+    }, [&](const std::string& id, size_t size) {
+        AddToGroup(frames, id, {1, size});
+    });
+
+    ++files;
+    if (error != ParseError::OK) {
+        ++errors[error];
+        return error;
+    }
+
+    AddValues(genres, genre, file_size);
+    AddValues(artists, artist, file_size);
+    AddValues(albums, album, file_size);
+    return error;
+}
+
+void LibraryStats::Merge(const LibraryStats& other) {
+    files += other.files;
+    for (const auto& [error, count] : other.errors) {
+        errors[error] += count;
+    }
+
+    MergeGroups(genres, other.genres);
+    MergeGroups(artists, other.artists);
+    MergeGroups(albums, other.albums);
+    MergeGroups(frames, other.frames);
+    for (size_t i = 0; i < encodings.size(); ++i) {
+        encodings[i].Merge(other.encodings[i]);
+    }
+
+    for (size_t i = 0; i < ratings.size(); ++i) {
+        ratings[i] += other.ratings[i];
+    }
+    popm_plays = SaturatingAdd(popm_plays, other.popm_plays);
+    pcnt_plays = SaturatingAdd(pcnt_plays, other.pcnt_plays);
+}
+
+LibraryStats AggregateLibrary(const std::vector<std::string>& files, size_t threads) {
+    threads = std::max<size_t>(1, std::min(threads, files.size()));
+    std::vector<LibraryStats> partial(threads);
+
+    // No locks on the hot path: every worker aggregates into its own stats
+    std::atomic<size_t> next_file(0);
+    auto worker = [&](LibraryStats& stats) {
+        for (size_t file = next_file++; file < files.size(); file = next_file++) {
+            stats.Add(files[file]);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (size_t i = 1; i < threads; ++i) {
+        pool.emplace_back(worker, std::ref(partial[i]));
+    }
+    worker(partial[0]);
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    for (size_t i = 1; i < threads; ++i) {
+        partial[0].Merge(partial[i]);
+        partial[i] = LibraryStats();
+    }
+    return std::move(partial[0]);
+}
+
+void PrintStats(std::ostream& out, const LibraryStats& stats, size_t top) {
+    out << "Files: " << stats.files << '\n';
+    for (const auto& [error, count] : stats.errors) {
+        out << '\t' << count << '\t' << ErrorToText(error) << '\n';
+    }
+
+    PrintGroups(out, "Genres", stats.genres, top);
+    PrintGroups(out, "Artists", stats.artists, top);
+    PrintGroups(out, "Albums", stats.albums, top);
+    PrintGroups(out, "Frames", stats.frames, top);
+
+    out << "Encodings:\n";
+    for (size_t i = 0; i < stats.encodings.size(); ++i) {
+        if (stats.encodings[i].count != 0) {
+            std::string name = i + 1 < stats.encodings.size() ? EncodingToText(i) : "invalid encoding";
+            out << '\t' << stats.encodings[i].count << '\t' << stats.encodings[i].bytes << '\t' << name << '\n';
+        }
+    }
+
+    out << "POPM ratings:\n";
+    for (size_t i = 0; i < stats.ratings.size(); ++i) {
+        if (stats.ratings[i] != 0) {
+            out << '\t' << i << '\t' << stats.ratings[i] << '\n';
+        }
+    }
+    out << "POPM plays: " << stats.popm_plays << '\n';
+    out << "PCNT plays: " << stats.pcnt_plays << '\n';
+}
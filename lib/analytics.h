@@ -0,0 +1,76 @@
+#pragma once
+#include "parser.h"
+#include <array>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Distinct keys kept per group-by, keys beyond the limit are counted under ANALYTICS_OTHER.
+// This bounds memory of a scan over any library by the number of workers, not files.
+const size_t ANALYTICS_MAX_GROUPS = 1 << 16;
+const char ANALYTICS_OTHER[] = "(other)";
+const char ANALYTICS_NONE[] = "(none)";
+// Encodings 0x00-0x03, the last slot counts frames with an invalid encoding byte
+const size_t ANALYTICS_ENCODINGS = 5;
+
+struct GroupStats {
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+
+    void Add(uint64_t size) {
+        ++count;
+        bytes += size;
+    }
+
+    void Merge(const GroupStats& other) {
+        count += other.count;
+        bytes += other.bytes;
+    }
+};
+
+// Hashes std::string and std::string_view alike, so groups can be looked up by a view
+struct GroupKeyHash {
+    using is_transparent = void;
+
+    size_t operator()(std::string_view key) const {
+        return std::hash<std::string_view>()(key);
+    }
+};
+
+using GroupMap = std::unordered_map<std::string, GroupStats, GroupKeyHash, std::equal_to<>>;
+
+// Aggregates of a part of the library. Every scanning thread fills its own
+// instance, instances are merged when the scan is over.
+struct LibraryStats {
+    uint64_t files = 0;
+    std::map<ParseError, uint64_t> errors;
+
+    // Files per UTF-8 value of the text frame, bytes are file sizes
+    GroupMap genres;
+    GroupMap artists;
+    GroupMap albums;
+
+    // Frames per frame ID (skipped unknown IDs too) and per text encoding, bytes are frame sizes
+    GroupMap frames;
+    std::array<GroupStats, ANALYTICS_ENCODINGS> encodings;
+
+    std::array<uint64_t, 256> ratings{};
+    uint64_t popm_plays = 0;
+    uint64_t pcnt_plays = 0;
+
+    // Parses the file and drops it as soon as its frames are counted.
+    // Group-bys by file take only fully parsed files, frames decoded before an error still count.
+    ParseError Add(const std::string& file);
+
+    void Merge(const LibraryStats& other);
+};
+
+void AddToGroup(GroupMap& groups, std::string_view key, const GroupStats& stats);
+
+LibraryStats AggregateLibrary(const std::vector<std::string>& files, size_t threads);
+
+// Totals and `top` largest groups of every group-by
+void PrintStats(std::ostream& out, const LibraryStats& stats, size_t top);
@@ -0,0 +1,166 @@
+#include "artwork_store.h"
+#include "fingerprint.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <fcntl.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+std::string Extension(const std::string& mime) {
+    size_t delim_pos = mime.find('/');
+    std::string extension = delim_pos == std::string::npos ? mime : mime.substr(delim_pos + 1);
+    for (char chr : extension) {
+        if (!std::isalnum(static_cast<unsigned char>(chr))) {
+            return ".bin";
+        }
+    }
+    return extension.empty() ? ".bin" : "." + extension;
+}
+
+std::string StoreName(uint64_t hash, size_t size, const std::string& mime) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx-%zu", static_cast<unsigned long long>(hash), size);
+    return name + Extension(mime);
+}
+
+bool ReadAt(int fd, char* data, size_t size, size_t offset) {
+    while (size > 0) {
+        ssize_t length = pread(fd, data, size, offset);
+        if (length <= 0) {
+            return false;
+        }
+        data += length;
+        size -= length;
+        offset += length;
+    }
+    return true;
+}
+
+bool WriteAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t length = write(fd, data, size);
+        if (length <= 0) {
+            return false;
+        }
+        data += length;
+        size -= length;
+    }
+    return true;
+}
+
+// Chunks are hashed one by one and their digests combined, like audio fingerprints,
+// so an image is never held in memory as a whole
+bool HashImage(int fd, const ArtworkRef& ref, std::string& chunk, uint64_t& hash) {
+    std::vector<uint64_t> digests;
+    digests.reserve(ref.size / chunk.size() + 1);
+    for (size_t done = 0; done < ref.size;) {
+        size_t length = std::min(chunk.size(), ref.size - done);
+        if (!ReadAt(fd, chunk.data(), length, ref.offset + done)) {
+            return false;
+        }
+        digests.push_back(HashBytes(chunk.data(), length, 0));
+        done += length;
+    }
+    hash = HashBytes(reinterpret_cast<const char*>(digests.data()), digests.size() * sizeof(uint64_t), ref.size);
+    return true;
+}
+
+// Pictures of chapters are sub-frames of CHAP, which may itself sit in a CTOC
+void CollectArtwork(const Frame& frame, std::vector<ArtworkRef>& refs) {
+    if (frame.Id() == "APIC") {
+        const auto& apic = static_cast<const APICFrame&>(frame);
+        ArtworkRef ref;
+        ref.picture_type = apic.PictureType();
+        ref.mime = apic.MimeType();
+        ref.offset = apic.ImageOffset();
+        ref.size = apic.ImageSize();
+        refs.push_back(std::move(ref));
+    } else if (frame.Id() == "CHAP" || frame.Id() == "CTOC") {
+        for (const auto& sub_frame : static_cast<const ElementFrame&>(frame).SubFrames()) {
+            CollectArtwork(*sub_frame, refs);
+        }
+    }
+}
+
+}  // namespace
+
+ParseError ReadArtwork(const std::string& file, std::vector<ArtworkRef>& refs) {
+    Header header;
+    return ParseFrames(file, header, [&](Frame& frame) {
+        CollectArtwork(frame, refs);
+    });
+}
+
+ParseError ArtworkStore::AddFile(const std::string& file, std::vector<ArtworkRef>& refs) {
+    size_t first = refs.size();
+    ParseError error = ReadArtwork(file, refs);
+    if (error != ParseError::OK || first == refs.size()) {
+        return error;
+    }
+
+    int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return ParseError::CANT_OPEN;
+    }
+
+    std::string chunk(FRAME_CHUNK_SIZE, '\0');
+    for (size_t i = first; i < refs.size() && error == ParseError::OK; ++i) {
+        ArtworkRef& ref = refs[i];
+        if (ref.mime == APIC_LINK_MIME) {
+            continue;
+        }
+
+        if (!HashImage(fd, ref, chunk, ref.hash)) {
+            error = ParseError::TRUNCATED;
+            break;
+        }
+
+        std::string name = StoreName(ref.hash, ref.size, ref.mime);
+        if (!Store(name, fd, ref, chunk, ref.added)) {
+            error = ParseError::WRITE_FAILED;
+        }
+        ref.path = directory + "/" + name;
+    }
+
+    close(fd);
+    return error;
+}
+
+bool ArtworkStore::Store(const std::string& name, int src_fd, const ArtworkRef& ref, std::string& chunk, bool& added) {
+    added = false;
+    std::string path = directory + "/" + name;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stored.count(name) != 0) {
+            return true;
+        }
+    }
+
+    // Left by an earlier run
+    if (access(path.c_str(), F_OK) != 0) {
+        // Written under a temporary name, so a crash never leaves a partial image under the real one
+        std::string temp = path + ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+        int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        bool ok = true;
+        for (size_t done = 0; ok && done < ref.size;) {
+            size_t length = std::min(chunk.size(), ref.size - done);
+            ok = ReadAt(src_fd, chunk.data(), length, ref.offset + done) && WriteAll(fd, chunk.data(), length);
+            done += length;
+        }
+        if (close(fd) != 0 || !ok || rename(temp.c_str(), path.c_str()) != 0) {
+            unlink(temp.c_str());
+            return false;
+        }
+        added = true;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    added = stored.insert(name).second && added;
+    return true;
+}
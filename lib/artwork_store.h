@@ -0,0 +1,50 @@
+#pragma once
+#include "parser.h"
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// MIME type of APIC frames whose data is a URL of the picture, not the picture
+const char APIC_LINK_MIME[] = "-->";
+
+struct ArtworkRef {
+    uint8_t picture_type = 0;
+    std::string mime;
+    size_t offset = 0;
+    size_t size = 0;
+
+    // Filled when the image is hashed
+    uint64_t hash = 0;
+    std::string path;
+    bool added = false;
+};
+
+// Content-addressed store of embedded pictures: a picture is named by its hash and
+// size, so the cover shared by every track of an album is written once.
+// Safe to use from several threads.
+class ArtworkStore {
+public:
+    explicit ArtworkStore(const std::string& directory) : directory(directory) {}
+
+    // Reads every picture of the file in chunks to hash it and copies the new ones to the store.
+    // Linked pictures (APIC_LINK_MIME) are returned with an empty path.
+    ParseError AddFile(const std::string& file, std::vector<ArtworkRef>& refs);
+
+    size_t Size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stored.size();
+    }
+
+private:
+    // Copies a new image from the source file through `chunk`
+    bool Store(const std::string& name, int src_fd, const ArtworkRef& ref, std::string& chunk, bool& added);
+
+    std::string directory;
+    mutable std::mutex mutex;
+    std::unordered_set<std::string> stored;
+};
+
+// Collects the pictures of the file, chapter pictures included, without reading their bytes.
+// Only a tag with a CRC within the frame budget is read as a whole, to check it.
+ParseError ReadArtwork(const std::string& file, std::vector<ArtworkRef>& refs);
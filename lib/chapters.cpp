@@ -0,0 +1,76 @@
+#include "chapters.h"
+#include <algorithm>
+#include <numeric>
+
+ChapterTable::ChapterTable(std::vector<Chapter> chapters) : chapters(std::move(chapters)) {
+    std::stable_sort(this->chapters.begin(), this->chapters.end(), [](const Chapter& lhs, const Chapter& rhs) {
+        return lhs.start_time < rhs.start_time;
+    });
+
+    start_times.reserve(this->chapters.size());
+    by_id.reserve(this->chapters.size());
+    for (size_t i = 0; i < this->chapters.size(); ++i) {
+        start_times.push_back(this->chapters[i].start_time);
+        // The first of chapters sharing an ID wins
+        by_id.emplace(this->chapters[i].element_id, i);
+    }
+    toc_order.resize(this->chapters.size());
+    std::iota(toc_order.begin(), toc_order.end(), 0);
+}
+
+size_t ChapterTable::At(uint32_t ms) const {
+    auto it = std::upper_bound(start_times.begin(), start_times.end(), ms);
+    if (it == start_times.begin()) {
+        return NONE;
+    }
+    size_t i = it - start_times.begin() - 1;
+    return ms < chapters[i].end_time ? i : NONE;
+}
+
+size_t ChapterTable::Find(const std::string& element_id) const {
+    auto it = by_id.find(element_id);
+    return it == by_id.end() ? NONE : it->second;
+}
+
+ParseError ReadChapters(const std::string& file, ChapterTable& table) {
+    std::vector<Chapter> chapters;
+    std::vector<std::string> toc;
+
+    Header header;
+    ParseError error = ParseFrames(file, header, [&](Frame& frame) {
+        if (frame.Id() == "CHAP") {
+            const auto& chap = static_cast<const CHAPFrame&>(frame);
+            Chapter chapter;
+            chapter.element_id = chap.ElementId();
+            chapter.start_time = chap.StartTime();
+            chapter.end_time = chap.EndTime();
+            chapter.start_offset = chap.StartOffset();
+            chapter.end_offset = chap.EndOffset();
+
+            const Frame* title = chap.SubFrame("TIT2");
+            if (title != nullptr && !static_cast<const TextFrame*>(title)->Values().empty()) {
+                chapter.title = static_cast<const TextFrame*>(title)->Values()[0];
+            }
+            chapters.push_back(std::move(chapter));
+        } else if (frame.Id() == "CTOC") {
+            const auto& ctoc = static_cast<const CTOCFrame&>(frame);
+            if (ctoc.TopLevel() && ctoc.Ordered()) {
+                toc = ctoc.Children();
+            }
+        }
+    });
+
+    table = ChapterTable(std::move(chapters));
+    if (!toc.empty()) {
+        // Entries may name nested tables of contents, those aren't chapters
+        std::vector<size_t> order;
+        for (const auto& element_id : toc) {
+            size_t i = table.Find(element_id);
+            if (i != ChapterTable::NONE) {
+                order.push_back(i);
+            }
+        }
+        table.toc_order = std::move(order);
+    }
+    return error;
+}
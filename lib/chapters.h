@@ -0,0 +1,55 @@
+#pragma once
+#include "parser.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct Chapter {
+    std::string element_id;
+    std::string title;
+    uint32_t start_time = 0;
+    uint32_t end_time = 0;
+    uint32_t start_offset = NO_CHAPTER_OFFSET;
+    uint32_t end_offset = NO_CHAPTER_OFFSET;
+};
+
+// Chapters of a file sorted by start time. Start times are kept in their own
+// array, so finding the chapter at a time is a binary search over one column.
+// Element IDs are hashed once when the table is built.
+class ChapterTable {
+public:
+    static const size_t NONE = static_cast<size_t>(-1);
+
+    ChapterTable() = default;
+    explicit ChapterTable(std::vector<Chapter> chapters);
+
+    size_t Size() const {
+        return chapters.size();
+    }
+
+    const Chapter& operator[](size_t i) const {
+        return chapters[i];
+    }
+
+    // Chapter playing at `ms`: the last one starting at or before it, if it hasn't ended yet
+    size_t At(uint32_t ms) const;
+
+    // Chapter by element ID, NONE if there is no such chapter
+    size_t Find(const std::string& element_id) const;
+
+    // Order of the top-level table of contents if the tag has an ordered one, start time order otherwise
+    const std::vector<size_t>& TocOrder() const {
+        return toc_order;
+    }
+
+private:
+    friend ParseError ReadChapters(const std::string& file, ChapterTable& table);
+
+    std::vector<Chapter> chapters;
+    std::vector<uint32_t> start_times;
+    std::vector<size_t> toc_order;
+    std::unordered_map<std::string, size_t> by_id;
+};
+
+// Collects CHAP frames (UTF-8 titles from their TIT2 sub-frame) and the top-level CTOC of the file
+ParseError ReadChapters(const std::string& file, ChapterTable& table);
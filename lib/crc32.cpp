@@ -0,0 +1,147 @@
+#include "crc32.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CRC32_CLMUL 1
+#endif
+
+namespace {
+
+const uint32_t POLYNOMIAL = 0xEDB88320;
+const size_t CLMUL_MIN_SIZE = 64;
+
+struct Tables {
+    uint32_t data[8][256];
+
+    Tables() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ (POLYNOMIAL & (0 - (crc & 1)));
+            }
+            data[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (size_t slice = 1; slice < 8; ++slice) {
+                data[slice][i] = (data[slice - 1][i] >> 8) ^ data[0][data[slice - 1][i] & 0xFF];
+            }
+        }
+    }
+};
+
+// Works on the inverted crc value
+uint32_t Crc32Table(const unsigned char* data, size_t size, uint32_t crc) {
+    static const Tables tables;
+    const auto& table = tables.data;
+
+    for (; size >= 8; data += 8, size -= 8) {
+        uint32_t low;
+        uint32_t high;
+        std::memcpy(&low, data, sizeof(low));
+        std::memcpy(&high, data + 4, sizeof(high));
+        low ^= crc;
+        crc = table[7][low & 0xFF] ^ table[6][(low >> 8) & 0xFF] ^ table[5][(low >> 16) & 0xFF] ^
+              table[4][low >> 24] ^ table[3][high & 0xFF] ^ table[2][(high >> 8) & 0xFF] ^
+              table[1][(high >> 16) & 0xFF] ^ table[0][high >> 24];
+    }
+    for (; size > 0; ++data, --size) {
+        crc = (crc >> 8) ^ table[0][(crc ^ *data) & 0xFF];
+    }
+    return crc;
+}
+
+#ifdef CRC32_CLMUL
+
+// Folding by four 128-bit lanes with constants for the reflected polynomial,
+// as in "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ" (Intel).
+// Needs size >= 64 and a multiple of 16; works on the inverted crc value.
+__attribute__((target("pclmul,sse4.1")))
+uint32_t Crc32Clmul(const unsigned char* data, size_t size, uint32_t crc) {
+    const __m128i k1k2 = _mm_set_epi64x(0x01C6E41596, 0x0154442BD4);
+    const __m128i k3k4 = _mm_set_epi64x(0x00CCAA009E, 0x01751997D0);
+    const __m128i k5k0 = _mm_set_epi64x(0x0000000000, 0x0163CD6124);
+    const __m128i poly = _mm_set_epi64x(0x01F7011641, 0x01DB710641);
+    const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+    __m128i x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    __m128i x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16));
+    __m128i x3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 32));
+    __m128i x4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 48));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(static_cast<int>(crc)));
+    data += 64;
+    size -= 64;
+
+    for (; size >= 64; data += 64, size -= 64) {
+        __m128i x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+        __m128i x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+        __m128i x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+        __m128i x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128(reinterpret_cast<const __m128i*>(data)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 32)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 48)));
+    }
+
+    // Four lanes into one
+    const __m128i lanes[] = {x2, x3, x4};
+    for (const __m128i& next : lanes) {
+        __m128i x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, next), x5);
+    }
+    for (; size >= 16; data += 16, size -= 16) {
+        __m128i x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data))), x5);
+    }
+
+    // 128 bits to 64
+    __m128i fold = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), fold);
+    fold = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, mask32);
+    x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);
+    x1 = _mm_xor_si128(x1, fold);
+
+    // Barrett reduction to 32 bits
+    fold = _mm_and_si128(x1, mask32);
+    fold = _mm_clmulepi64_si128(fold, poly, 0x10);
+    fold = _mm_and_si128(fold, mask32);
+    fold = _mm_clmulepi64_si128(fold, poly, 0x00);
+    x1 = _mm_xor_si128(x1, fold);
+    return static_cast<uint32_t>(_mm_extract_epi32(x1, 1));
+}
+
+bool HasClmul() {
+    static const bool supported = __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+    return supported;
+}
+
+#endif
+
+}  // namespace
+
+uint32_t Crc32(const char* data, size_t size, uint32_t crc) {
+    const unsigned char* ptr = reinterpret_cast<const unsigned char*>(data);
+    crc = ~crc;
+
+#ifdef CRC32_CLMUL
+    if (size >= CLMUL_MIN_SIZE && HasClmul()) {
+        size_t chunk = size & ~static_cast<size_t>(15);
+        crc = Crc32Clmul(ptr, chunk, crc);
+        ptr += chunk;
+        size -= chunk;
+    }
+#endif
+
+    return ~Crc32Table(ptr, size, crc);
+}
+
+uint32_t Crc32Portable(const char* data, size_t size, uint32_t crc) {
+    return ~Crc32Table(reinterpret_cast<const unsigned char*>(data), size, ~crc);
+}
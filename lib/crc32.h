@@ -0,0 +1,11 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// CRC-32 of ISO 3309 (the one of zlib and ID3v2 extended header).
+// Uses carry-less multiplication (PCLMULQDQ) when the CPU has it and a
+// slicing-by-8 table otherwise. `crc` is the value for the preceding data.
+uint32_t Crc32(const char* data, size_t size, uint32_t crc = 0);
+
+// Same CRC through the table only, the reference the fast path is checked against
+uint32_t Crc32Portable(const char* data, size_t size, uint32_t crc = 0);
@@ -0,0 +1,220 @@
+#include "fingerprint.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <thread>
+
+namespace {
+
+const uint64_t PRIME_1 = 0x9E3779B185EBCA87ULL;
+const uint64_t PRIME_2 = 0xC2B2AE3D27D4EB4FULL;
+const uint64_t PRIME_3 = 0x165667B19E3779F9ULL;
+const uint64_t PRIME_4 = 0x85EBCA77C2B2AE63ULL;
+const uint64_t PRIME_5 = 0x27D4EB2F165667C5ULL;
+const size_t STRIPE_SIZE = 32;
+
+uint64_t Rotl(uint64_t x, int bits) {
+    return (x << bits) | (x >> (64 - bits));
+}
+
+uint64_t Load64(const char* ptr) {
+    uint64_t value;
+    std::memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+uint32_t Load32(const char* ptr) {
+    uint32_t value;
+    std::memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+uint64_t Round(uint64_t acc, uint64_t input) {
+    acc += input * PRIME_2;
+    acc = Rotl(acc, 31);
+    return acc * PRIME_1;
+}
+
+uint64_t MergeRound(uint64_t acc, uint64_t value) {
+    acc ^= Round(0, value);
+    return acc * PRIME_1 + PRIME_4;
+}
+
+struct ChunkJob {
+    size_t file;
+    size_t offset;
+    size_t size;
+};
+
+// Runs the worker on the calling thread and `threads - 1` more
+void RunWorkers(size_t threads, const std::function<void()>& worker) {
+    std::vector<std::thread> pool;
+    for (size_t i = 1; i < threads; ++i) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : pool) {
+        thread.join();
+    }
+}
+
+}  // namespace
+
+// XXH64 layout: four independent lanes over 32-byte stripes, so the main loop has
+// no dependency between lanes and keeps the multipliers busy.
+uint64_t HashBytes(const char* data, size_t size, uint64_t seed) {
+    const char* ptr = data;
+    const char* end = data + size;
+    uint64_t hash;
+
+    if (size >= STRIPE_SIZE) {
+        uint64_t lanes[4] = {seed + PRIME_1 + PRIME_2, seed + PRIME_2, seed, seed - PRIME_1};
+        const char* limit = end - STRIPE_SIZE;
+        do {
+            for (size_t i = 0; i < 4; ++i) {
+                lanes[i] = Round(lanes[i], Load64(ptr + i * 8));
+            }
+            ptr += STRIPE_SIZE;
+        } while (ptr <= limit);
+
+        hash = Rotl(lanes[0], 1) + Rotl(lanes[1], 7) + Rotl(lanes[2], 12) + Rotl(lanes[3], 18);
+        for (size_t i = 0; i < 4; ++i) {
+            hash = MergeRound(hash, lanes[i]);
+        }
+    } else {
+        hash = seed + PRIME_5;
+    }
+
+    hash += size;
+    for (; ptr + 8 <= end; ptr += 8) {
+        hash ^= Round(0, Load64(ptr));
+        hash = Rotl(hash, 27) * PRIME_1 + PRIME_4;
+    }
+    if (ptr + 4 <= end) {
+        hash ^= static_cast<uint64_t>(Load32(ptr)) * PRIME_1;
+        hash = Rotl(hash, 23) * PRIME_2 + PRIME_3;
+        ptr += 4;
+    }
+    for (; ptr < end; ++ptr) {
+        hash ^= static_cast<unsigned char>(*ptr) * PRIME_5;
+        hash = Rotl(hash, 11) * PRIME_1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= PRIME_2;
+    hash ^= hash >> 29;
+    hash *= PRIME_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+AudioFingerprint FingerprintAudio(const std::string& file, size_t threads) {
+    return FingerprintAudio(std::vector<std::string>{file}, threads)[0];
+}
+
+std::vector<AudioFingerprint> FingerprintAudio(const std::vector<std::string>& files, size_t threads) {
+    std::vector<AudioFingerprint> result(files.size());
+    std::vector<AudioRange> ranges(files.size());
+
+    // Audio ranges are located in parallel too, each takes a few reads of the file
+    std::atomic<size_t> next_file(0);
+    RunWorkers(std::max<size_t>(1, std::min(threads, files.size())), [&]() {
+        for (size_t i = next_file++; i < files.size(); i = next_file++) {
+            std::ifstream in(files[i], std::ios::binary);
+            if (!in.is_open()) {
+                result[i].error = ParseError::CANT_OPEN;
+                continue;
+            }
+            ranges[i] = GetAudioRange(in);
+            result[i].error = ranges[i].error;
+        }
+    });
+
+    // Chunks of all files go to one queue: small files are hashed file-per-thread,
+    // large files are spread over all threads.
+    std::vector<size_t> first_chunk(files.size() + 1, 0);
+    std::vector<ChunkJob> jobs;
+    for (size_t i = 0; i < files.size(); ++i) {
+        first_chunk[i] = jobs.size();
+        // Empty files and tags that run past the end of the file have no audio to compare
+        if (result[i].error != ParseError::OK || ranges[i].end == 0) {
+            continue;
+        }
+        result[i].valid = true;
+        result[i].size = ranges[i].end - ranges[i].begin;
+        for (size_t offset = ranges[i].begin; offset < ranges[i].end; offset += FINGERPRINT_CHUNK_SIZE) {
+            jobs.push_back({i, offset, std::min(FINGERPRINT_CHUNK_SIZE, ranges[i].end - offset)});
+        }
+    }
+    first_chunk[files.size()] = jobs.size();
+
+    std::vector<uint64_t> digests(jobs.size());
+    std::vector<char> failed(jobs.size(), false);
+    std::atomic<size_t> next_job(0);
+    auto worker = [&]() {
+        std::string buffer(FINGERPRINT_CHUNK_SIZE, '\0');
+        std::ifstream in;
+        size_t opened = files.size();
+        for (size_t job = next_job++; job < jobs.size(); job = next_job++) {
+            const ChunkJob& chunk = jobs[job];
+            if (opened != chunk.file) {
+                in.close();
+                in.clear();
+                in.open(files[chunk.file], std::ios::binary);
+                opened = chunk.file;
+            }
+
+            // A file that shrank or can't be read any more must not match anything
+            in.seekg(chunk.offset, std::ios::beg);
+            if (!in.read(buffer.data(), chunk.size)) {
+                failed[job] = true;
+                in.clear();
+                continue;
+            }
+            digests[job] = HashBytes(buffer.data(), chunk.size, 0);
+        }
+    };
+
+    RunWorkers(std::max<size_t>(1, std::min(threads, jobs.size())), worker);
+
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (!result[i].valid) {
+            continue;
+        }
+
+        const uint64_t* begin = digests.data() + first_chunk[i];
+        size_t count = first_chunk[i + 1] - first_chunk[i];
+        if (std::find(failed.begin() + first_chunk[i], failed.begin() + first_chunk[i + 1], true) !=
+            failed.begin() + first_chunk[i + 1]) {
+            result[i].valid = false;
+            result[i].error = ParseError::TRUNCATED;
+            continue;
+        }
+        result[i].hash = HashBytes(reinterpret_cast<const char*>(begin), count * sizeof(uint64_t), result[i].size);
+    }
+
+    return result;
+}
+
+std::vector<std::vector<std::string>> FindDuplicates(const std::vector<std::string>& files, size_t threads) {
+    std::vector<AudioFingerprint> fingerprints = FingerprintAudio(files, threads);
+
+    std::map<std::pair<size_t, uint64_t>, std::vector<std::string>> groups;
+    for (size_t i = 0; i < files.size(); ++i) {
+        // Files that are only tags would all be duplicates of each other
+        if (fingerprints[i].valid && fingerprints[i].size != 0) {
+            groups[{fingerprints[i].size, fingerprints[i].hash}].push_back(files[i]);
+        }
+    }
+
+    std::vector<std::vector<std::string>> duplicates;
+    for (auto& [key, group] : groups) {
+        if (group.size() > 1) {
+            duplicates.push_back(std::move(group));
+        }
+    }
+
+    return duplicates;
+}
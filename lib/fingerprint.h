@@ -0,0 +1,34 @@
+#pragma once
+#include "parser.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Audio payload is split into chunks of this size, chunks are hashed independently
+// (possibly by different threads) and their digests are combined in order,
+// so fingerprint doesn't depend on the number of threads.
+const size_t FINGERPRINT_CHUNK_SIZE = 4 << 20;
+
+struct AudioFingerprint {
+    // False for files that are empty, can't be read or whose tag claims more bytes than the file has
+    bool valid = false;
+    // Why a file isn't valid: CANT_OPEN, an error of its tag or TRUNCATED if it shrank
+    // while it was read. OK for an empty file.
+    ParseError error = ParseError::OK;
+    size_t size = 0;
+    uint64_t hash = 0;
+
+    bool operator==(const AudioFingerprint& other) const {
+        return size == other.size && hash == other.hash;
+    }
+};
+
+uint64_t HashBytes(const char* data, size_t size, uint64_t seed);
+
+AudioFingerprint FingerprintAudio(const std::string& file, size_t threads);
+
+std::vector<AudioFingerprint> FingerprintAudio(const std::vector<std::string>& files, size_t threads);
+
+// Groups files with identical audio payload regardless of their tags.
+// Only groups of two or more files are returned, files without audio are never grouped.
+std::vector<std::vector<std::string>> FindDuplicates(const std::vector<std::string>& files, size_t threads);
@@ -0,0 +1,223 @@
+#include "id3parse.h"
+#include "crc32.h"
+#include "parser.h"
+#include "probe.h"
+#include <fcntl.h>
+#include <new>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(ID3_OK == static_cast<int>(ParseError::OK), "C error codes follow ParseError");
+static_assert(ID3_BAD_CRC == static_cast<int>(ParseError::BAD_CRC), "C error codes follow ParseError");
+static_assert(ID3_WRITE_FAILED == static_cast<int>(ParseError::WRITE_FAILED), "C error codes follow ParseError");
+
+struct id3_parser {
+    // Tag read from a file, reused by the next open
+    std::string buffer;
+
+    Header header;
+    int error = ID3_NOT_OPEN;
+    const unsigned char* frames = nullptr;
+    size_t frames_size = 0;
+};
+
+namespace {
+
+int ToC(ParseError error) {
+    return static_cast<int>(error);
+}
+
+// Frame size like ReadFrameSize: plain in v2.3, synchsafe in v2.4 with INVALID_SIZE
+// when a byte has its highest bit set
+size_t DecodeFrameSize(const unsigned char* data, bool synchsafe) {
+    size_t size = 0;
+    for (size_t i = 0; i < 4; ++i) {
+        if (synchsafe && (data[i] & 0x80)) {
+            return INVALID_SIZE;
+        }
+        size = synchsafe ? size << 7 | data[i] : size << 8 | data[i];
+    }
+    return size;
+}
+
+bool ReadAt(int fd, char* data, size_t size, off_t offset) {
+    while (size > 0) {
+        ssize_t length = pread(fd, data, size, offset);
+        if (length <= 0) {
+            return false;
+        }
+        data += length;
+        size -= length;
+        offset += length;
+    }
+    return true;
+}
+
+// `data` holds the whole tag, starting with its header
+int Load(id3_parser* parser, const char* data, size_t size) {
+    parser->header = Header();
+    MemoryBuffer buffer(data, size);
+    std::istream in(&buffer);
+    ParseError error = ReadHeader(in, parser->header);
+    if (error != ParseError::OK) {
+        return parser->error = ToC(error);
+    }
+
+    const Header& header = parser->header;
+    if (HEADER_SIZE + header.size > size) {
+        return parser->error = ID3_TRUNCATED;
+    }
+
+    const char* frames = data + HEADER_SIZE + header.ext_size;
+    size_t frames_size = header.size - header.ext_size;
+    if (header.crc_present && Crc32(frames, frames_size - header.padding) != header.crc) {
+        return parser->error = ID3_BAD_CRC;
+    }
+
+    parser->frames = reinterpret_cast<const unsigned char*>(frames);
+    parser->frames_size = frames_size;
+    return parser->error = ID3_OK;
+}
+
+void Reset(id3_parser* parser) {
+    parser->error = ID3_NOT_OPEN;
+    parser->frames = nullptr;
+    parser->frames_size = 0;
+}
+
+}  // namespace
+
+id3_parser* id3_parser_new(void) {
+    return new (std::nothrow) id3_parser();
+}
+
+void id3_parser_free(id3_parser* parser) {
+    delete parser;
+}
+
+int id3_parser_open_path(id3_parser* parser, const char* path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        Reset(parser);
+        return parser->error = ID3_CANT_OPEN;
+    }
+    int error = id3_parser_open_fd(parser, fd);
+    close(fd);
+    return error;
+}
+
+int id3_parser_open_fd(id3_parser* parser, int fd) {
+    Reset(parser);
+
+    char data[HEADER_SIZE];
+    ssize_t length = pread(fd, data, sizeof(data), 0);
+    if (length < 0) {
+        return parser->error = ID3_CANT_OPEN;
+    }
+    Header header;
+    ParseError error = DecodeHeader(data, length, header);
+    if (error != ParseError::OK) {
+        return parser->error = ToC(error);
+    }
+
+    // Checked before the buffer grows, a broken size must not allocate 256 MiB
+    struct stat info;
+    if (fstat(fd, &info) != 0 || HEADER_SIZE + header.size > static_cast<size_t>(info.st_size)) {
+        return parser->error = ID3_TRUNCATED;
+    }
+
+    try {
+        parser->buffer.resize(HEADER_SIZE + header.size);
+    } catch (const std::bad_alloc&) {
+        return parser->error = ID3_NO_MEMORY;
+    }
+    if (!ReadAt(fd, parser->buffer.data(), parser->buffer.size(), 0)) {
+        return parser->error = ID3_TRUNCATED;
+    }
+    return Load(parser, parser->buffer.data(), parser->buffer.size());
+}
+
+int id3_parser_open_memory(id3_parser* parser, const void* data, size_t size) {
+    Reset(parser);
+    return Load(parser, static_cast<const char*>(data), size);
+}
+
+int id3_parser_frames(const id3_parser* parser, id3_frame_callback callback, void* user) {
+    if (parser->error != ID3_OK) {
+        return parser->error;
+    }
+
+    const unsigned char* frames = parser->frames;
+    bool synchsafe = parser->header.version[0] != 0x03;
+    size_t cur_byte = 0;
+    while (cur_byte + HEADER_SIZE <= parser->frames_size) {
+        const unsigned char* frame = frames + cur_byte;
+        if (frame[0] == 0x00) {
+            break;  // padding
+        }
+
+        size_t size = DecodeFrameSize(frame + FRAME_ID_SIZE, synchsafe);
+        if (size > parser->frames_size - cur_byte - HEADER_SIZE) {
+            return ID3_BAD_SIZE;
+        }
+
+        uint16_t flags = frame[FRAME_ID_SIZE + 4] << 8 | frame[FRAME_ID_SIZE + 5];
+        if (callback(reinterpret_cast<const char*>(frame), flags, frame + HEADER_SIZE, size, user) != 0) {
+            break;
+        }
+        cur_byte += HEADER_SIZE + size;
+    }
+    return ID3_OK;
+}
+
+unsigned id3_parser_version(const id3_parser* parser) {
+    if (parser->error != ID3_OK) {
+        return 0;
+    }
+    const std::string& version = parser->header.version;
+    return static_cast<unsigned char>(version[0]) << 8 | static_cast<unsigned char>(version[1]);
+}
+
+size_t id3_parser_tag_size(const id3_parser* parser) {
+    return parser->error == ID3_OK ? parser->header.size : 0;
+}
+
+int id3_probe_path(const char* path, int check_end, id3_probe_result* result) {
+    *result = id3_probe_result();
+    ProbeResult probe;
+    result->error = ToC(Probe(path, check_end != 0, probe));
+    result->file_size = probe.file_size;
+    if (probe.error == ParseError::OK || probe.error == ParseError::TRUNCATED) {
+        const Header& header = probe.header;
+        result->version = static_cast<unsigned char>(header.version[0]) << 8 | static_cast<unsigned char>(header.version[1]);
+        result->flags = (header.unsync ? 0x80 : 0) | (header.ext_header ? 0x40 : 0) | (header.exp_ind ? 0x20 : 0) |
+                        (header.footer ? 0x10 : 0);
+        result->tag_size = header.size;
+    }
+    result->id3v1 = probe.id3v1;
+    result->appended_size = probe.appended_tag ? probe.appended_size : 0;
+    return result->error;
+}
+
+const char* id3_error_text(int error) {
+    switch (error) {
+        case ID3_NO_MEMORY:
+            return "Not enough memory for the tag";
+        case ID3_NOT_OPEN:
+            return "Nothing is opened by the parser";
+        default:
+            break;
+    }
+    if (error < ID3_OK || error > ID3_WRITE_FAILED) {
+        return "Unknown error";
+    }
+
+    // Texts live as long as the library
+    static const std::string texts[] = {
+        ErrorToText(ParseError::OK),        ErrorToText(ParseError::CANT_OPEN),
+        ErrorToText(ParseError::NOT_ID3),   ErrorToText(ParseError::TRUNCATED),
+        ErrorToText(ParseError::BAD_SIZE),  ErrorToText(ParseError::BAD_ENCODING),
+        ErrorToText(ParseError::BAD_CRC),   ErrorToText(ParseError::WRITE_FAILED),
+    };
+    return texts[error].c_str();
+}
@@ -0,0 +1,91 @@
+#ifndef ID3PARSE_H
+#define ID3PARSE_H
+
+/* C interface of libid3parse. Frames are delivered raw: the callback gets
+ * pointers into the tag (the caller's buffer or the handle's own one), nothing
+ * is copied or decoded per frame. A handle can be reopened any number of times
+ * and keeps its buffer between files, so a long running service allocates only
+ * when it meets a tag larger than any before.
+ *
+ * Handles are not thread safe, use one handle per thread. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define ID3PARSE_API __attribute__((visibility("default")))
+#else
+#define ID3PARSE_API
+#endif
+
+/* Same values as ParseError of the C++ library, new codes are only appended */
+enum id3_error {
+    ID3_OK = 0,
+    ID3_CANT_OPEN = 1,
+    ID3_NOT_ID3 = 2,
+    ID3_TRUNCATED = 3,
+    ID3_BAD_SIZE = 4,
+    ID3_BAD_ENCODING = 5,
+    ID3_BAD_CRC = 6,
+    ID3_WRITE_FAILED = 7,
+    ID3_NO_MEMORY = 8,
+    ID3_NOT_OPEN = 9
+};
+
+typedef struct id3_parser id3_parser;
+
+/* `id` points to the 4 bytes of the frame ID (not zero terminated), `flags` are
+ * the two flag bytes big-endian, `data` and `size` are the frame content.
+ * Pointers are valid until the handle is reopened or freed.
+ * Returning non-zero stops the iteration. */
+typedef int (*id3_frame_callback)(const char* id, uint16_t flags, const unsigned char* data, size_t size,
+                                  void* user);
+
+ID3PARSE_API id3_parser* id3_parser_new(void);
+ID3PARSE_API void id3_parser_free(id3_parser* parser);
+
+/* Read the tag header (with the extended header and its CRC-32 check) and keep
+ * the tag for id3_parser_frames. The fd is read with pread, its offset is kept
+ * and it isn't closed. The memory buffer isn't copied and must outlive its use. */
+ID3PARSE_API int id3_parser_open_path(id3_parser* parser, const char* path);
+ID3PARSE_API int id3_parser_open_fd(id3_parser* parser, int fd);
+ID3PARSE_API int id3_parser_open_memory(id3_parser* parser, const void* data, size_t size);
+
+/* Calls `callback` for every frame of the opened tag until padding or the end of the tag.
+ * ID3_BAD_SIZE if a frame size isn't synchsafe (v2.4) or runs past the tag. */
+ID3PARSE_API int id3_parser_frames(const id3_parser* parser, id3_frame_callback callback, void* user);
+
+/* Major version in the high byte, revision in the low one, 0 if nothing is open */
+ID3PARSE_API unsigned id3_parser_version(const id3_parser* parser);
+/* Tag size without the 10-byte header */
+ID3PARSE_API size_t id3_parser_tag_size(const id3_parser* parser);
+
+/* Header census of a file without a handle and without reading any frame */
+typedef struct id3_probe_result {
+    /* Header fields are set for ID3_OK and ID3_TRUNCATED */
+    int error;
+    unsigned version;
+    /* Header flag byte: 0x80 unsynchronisation, 0x40 extended header, 0x20 experimental, 0x10 footer */
+    unsigned flags;
+    size_t tag_size;
+    uint64_t file_size;
+    /* Set only with `check_end` */
+    int id3v1;
+    size_t appended_size; /* 0 without an appended tag */
+} id3_probe_result;
+
+/* Reads the 10-byte header with one pread and, with `check_end`, the last 138 bytes
+ * with one more to find an ID3v1 tag and the footer of an appended tag */
+ID3PARSE_API int id3_probe_path(const char* path, int check_end, id3_probe_result* result);
+
+ID3PARSE_API const char* id3_error_text(int error);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
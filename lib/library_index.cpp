@@ -0,0 +1,194 @@
+#include "library_index.h"
+#include <algorithm>
+#include <mutex>
+
+ParseError LibraryIndex::Update(const std::string& path) {
+    std::lock_guard update_lock(update_mutex);
+    IndexEntry entry;
+    entry.error = ParseInterned(path, *pool, entry.fields);
+    if (entry.error == ParseError::NOT_ID3 || entry.error == ParseError::CANT_OPEN) {
+        std::unique_lock lock(mutex);
+        auto it = entries.find(path);
+        if (it != entries.end()) {
+            RemovePostings(it->second);
+            entries.erase(it);
+        }
+        return entry.error;
+    }
+
+    entry.path_id = pool->Intern(path);
+    ParseError error = entry.error;
+    std::unique_lock lock(mutex);
+    auto it = entries.find(path);
+    if (it != entries.end()) {
+        RemovePostings(it->second);
+        it->second = std::move(entry);
+    } else {
+        it = entries.emplace(path, std::move(entry)).first;
+    }
+    AddPostings(it->second);
+    lock.unlock();
+
+    Compact();
+    return error;
+}
+
+void LibraryIndex::Remove(const std::string& path) {
+    std::lock_guard update_lock(update_mutex);
+    {
+        std::unique_lock lock(mutex);
+        auto it = entries.find(path);
+        if (it != entries.end()) {
+            RemovePostings(it->second);
+            entries.erase(it);
+        }
+    }
+    Compact();
+}
+
+void LibraryIndex::RemoveDirectory(const std::string& dir) {
+    std::string prefix = dir.back() == '/' ? dir : dir + '/';
+    std::lock_guard update_lock(update_mutex);
+    {
+        std::unique_lock lock(mutex);
+        for (auto it = entries.begin(); it != entries.end();) {
+            if (it->first.compare(0, prefix.size(), prefix) == 0) {
+                RemovePostings(it->second);
+                it = entries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    Compact();
+}
+
+std::vector<std::string> LibraryIndex::PathsUnder(const std::string& dir) const {
+    std::string prefix = dir.back() == '/' ? dir : dir + '/';
+    std::vector<std::string> paths;
+    std::shared_lock lock(mutex);
+    for (const auto& [path, entry] : entries) {
+        if (path.compare(0, prefix.size(), prefix) == 0) {
+            paths.push_back(path);
+        }
+    }
+    return paths;
+}
+
+bool LibraryIndex::Find(const std::string& path, IndexEntry& entry, std::shared_ptr<const StringPool>& pool) const {
+    std::shared_lock lock(mutex);
+    auto it = entries.find(path);
+    if (it == entries.end()) {
+        return false;
+    }
+
+    entry = it->second;
+    pool = this->pool;
+    return true;
+}
+
+std::vector<std::string> LibraryIndex::FindByFrame(const std::string& frame_id) const {
+    std::shared_lock lock(mutex);
+    uint32_t id;
+    if (!pool->Find(frame_id, id)) {
+        return {};
+    }
+
+    auto it = by_frame.find(id);
+    return it == by_frame.end() ? std::vector<std::string>() : Paths(it->second);
+}
+
+std::vector<std::string> LibraryIndex::FindByValue(const std::string& frame_id, const std::string& value) const {
+    std::shared_lock lock(mutex);
+    uint32_t id;
+    uint32_t value_id;
+    if (!pool->Find(frame_id, id) || !pool->Find(value, value_id)) {
+        return {};
+    }
+
+    auto it = by_value.find(ValueKey(id, value_id));
+    return it == by_value.end() ? std::vector<std::string>() : Paths(it->second);
+}
+
+size_t LibraryIndex::Size() const {
+    std::shared_lock lock(mutex);
+    return entries.size();
+}
+
+void LibraryIndex::AddPostings(const IndexEntry& entry) {
+    live_fields += entry.fields.size() + 1;
+    for (const auto& field : entry.fields) {
+        by_frame[field.frame_id].insert(entry.path_id);
+        if (field.value != 0) {
+            by_value[ValueKey(field.frame_id, field.value)].insert(entry.path_id);
+        }
+    }
+}
+
+void LibraryIndex::RemovePostings(const IndexEntry& entry) {
+    live_fields -= entry.fields.size() + 1;
+    stale_fields += entry.fields.size() + 1;
+    for (const auto& field : entry.fields) {
+        auto frame = by_frame.find(field.frame_id);
+        if (frame != by_frame.end()) {
+            frame->second.erase(entry.path_id);
+            if (frame->second.empty()) {
+                by_frame.erase(frame);
+            }
+        }
+
+        auto value = by_value.find(ValueKey(field.frame_id, field.value));
+        if (value != by_value.end()) {
+            value->second.erase(entry.path_id);
+            if (value->second.empty()) {
+                by_value.erase(value);
+            }
+        }
+    }
+}
+
+std::vector<std::string> LibraryIndex::Paths(const Postings& postings) const {
+    std::vector<std::string> paths;
+    paths.reserve(postings.size());
+    for (uint32_t path_id : postings) {
+        paths.emplace_back(pool->View(path_id));
+    }
+    return paths;
+}
+
+void LibraryIndex::Compact() {
+    if (stale_fields <= std::max(live_fields, INDEX_COMPACT_MIN_FIELDS)) {
+        return;
+    }
+
+    // Only writers change the maps and they are locked out, so the copy is built without
+    // blocking readers and swapped in at once
+    auto new_pool = std::make_shared<StringPool>();
+    auto remap = [&](uint32_t& id) {
+        id = new_pool->Intern(pool->View(id));
+    };
+
+    LibraryIndex compacted;
+    compacted.pool = new_pool;
+    compacted.entries.reserve(entries.size());
+    for (const auto& [path, entry] : entries) {
+        IndexEntry copy = entry;
+        remap(copy.path_id);
+        for (auto& field : copy.fields) {
+            remap(field.frame_id);
+            remap(field.key);
+            remap(field.desc);
+            remap(field.value);
+        }
+        compacted.AddPostings(copy);
+        compacted.entries.emplace(path, std::move(copy));
+    }
+
+    std::unique_lock lock(mutex);
+    pool = std::move(compacted.pool);
+    entries = std::move(compacted.entries);
+    by_frame = std::move(compacted.by_frame);
+    by_value = std::move(compacted.by_value);
+    live_fields = compacted.live_fields;
+    stale_fields = 0;
+}
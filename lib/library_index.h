@@ -0,0 +1,71 @@
+#pragma once
+#include "parser.h"
+#include "string_pool.h"
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+struct IndexEntry {
+    ParseError error = ParseError::OK;
+    uint32_t path_id = 0;
+    std::vector<InternedField> fields;
+};
+
+// Strings of replaced and removed entries stay in the pool until it's rebuilt
+const size_t INDEX_COMPACT_MIN_FIELDS = 64 * 1024;
+
+// In-memory metadata of a library keyed by file path. Strings of all files share
+// one StringPool. Safe to read from many threads while another one updates it.
+// The pool never frees a string, so once the fields of replaced and removed entries
+// outnumber the live ones, the index re-interns its live strings into a new pool.
+class LibraryIndex {
+public:
+    LibraryIndex() : pool(std::make_shared<StringPool>()) {}
+
+    // Re-parses the file and replaces its entry. Files without ID3v2 tag are dropped.
+    ParseError Update(const std::string& path);
+
+    void Remove(const std::string& path);
+
+    // Removes every file under the directory
+    void RemoveDirectory(const std::string& dir);
+
+    // Indexed files under the directory
+    std::vector<std::string> PathsUnder(const std::string& dir) const;
+
+    // Ids of the entry are resolved in `pool`, which stays valid after the index drops it
+    bool Find(const std::string& path, IndexEntry& entry, std::shared_ptr<const StringPool>& pool) const;
+
+    // Paths of files having the frame / having the frame with exactly this value
+    std::vector<std::string> FindByFrame(const std::string& frame_id) const;
+    std::vector<std::string> FindByValue(const std::string& frame_id, const std::string& value) const;
+
+    size_t Size() const;
+
+private:
+    using Postings = std::unordered_set<uint32_t>;
+
+    static uint64_t ValueKey(uint32_t frame_id, uint32_t value) {
+        return static_cast<uint64_t>(frame_id) << 32 | value;
+    }
+
+    void AddPostings(const IndexEntry& entry);
+    void RemovePostings(const IndexEntry& entry);
+    std::vector<std::string> Paths(const Postings& postings) const;
+    void Compact();
+
+    // Writers hold `update_mutex` for the whole update, so the pool isn't replaced while
+    // a file is interned into it; `mutex` guards the maps and the pool pointer for readers.
+    std::mutex update_mutex;
+    std::shared_ptr<StringPool> pool;
+    mutable std::shared_mutex mutex;
+    size_t live_fields = 0;
+    size_t stale_fields = 0;
+    std::unordered_map<std::string, IndexEntry> entries;
+    std::unordered_map<uint32_t, Postings> by_frame;
+    std::unordered_map<uint64_t, Postings> by_value;
+};
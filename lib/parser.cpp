@@ -1,43 +1,217 @@
 #include "parser.h"
+#include "alloc_profile.h"
+#include "crc32.h"
+#include <algorithm>
+#include <atomic>
+
+// Valid UTF-16 never converts to a lone 0xFF byte
+const std::string ENCODING_ERROR = "\xFF";
+
+namespace {
+
+std::atomic<size_t> frame_budget(DEFAULT_FRAME_BUDGET);
+
+// Frame sizes of the tag this thread decodes, TakeFrames clears it for v2.3
+thread_local bool synchsafe_frame_sizes = true;
+
+uint32_t ReadBigEndian(std::istream& in) {
+    uint32_t value = 0;
+    for (size_t i = 0; i < 4; ++i) {
+        value = value << 8 | static_cast<unsigned char>(in.get());
+    }
+    return value;
+}
+
+// v2.3: size without its own 4 bytes (6 or 10), 2 flag bytes, padding size and the CRC when flagged
+ParseError ReadExtendedHeaderV3(std::istream& in, Header& header) {
+    size_t size = ReadBigEndian(in);
+    char flags = in.get();
+    in.get();
+    header.padding = ReadBigEndian(in);
+    if ((size != 6 && size != 10) || 4 + size > header.size || header.padding > header.size - 4 - size) {
+        return ParseError::BAD_SIZE;
+    }
+    header.ext_size = 4 + size;
+
+    if (IsBitSet(flags, 7)) {
+        if (size != 10) return ParseError::BAD_SIZE;
+        header.crc_present = true;
+        header.crc = ReadBigEndian(in);
+    } else {
+        in.seekg(size - 6, in.cur);
+    }
+    return ParseError::OK;
+}
+
+// v2.4: synchsafe size of the whole extended header, then every flag is followed by the length of its data
+ParseError ReadExtendedHeaderV4(std::istream& in, Header& header) {
+    header.ext_size = ReadSize(in);
+    char flag_bytes = in.get();
+    char ext_flags = in.get();
+    size_t used = 4 + 1 + 1;
+    if (header.ext_size < used || header.ext_size > header.size || flag_bytes != 0x01) {
+        return ParseError::BAD_SIZE;
+    }
+
+    if (IsBitSet(ext_flags, 6)) {
+        header.update = true;
+        used += 1;
+        if (in.get() != 0x00) return ParseError::BAD_SIZE;
+    }
+    if (IsBitSet(ext_flags, 5)) {
+        header.crc_present = true;
+        used += 1 + 5;
+        if (in.get() != 0x05) return ParseError::BAD_SIZE;
+        for (size_t i = 0; i < 5; ++i) {
+            header.crc = header.crc << 7 | (in.get() & 0x7F);
+        }
+    }
+    if (IsBitSet(ext_flags, 4)) {
+        header.restricted = true;
+        used += 1 + 1;
+        if (in.get() != 0x01) return ParseError::BAD_SIZE;
+        header.restrictions = in.get();
+    }
+
+    if (used > header.ext_size) {
+        return ParseError::BAD_SIZE;
+    }
+    in.seekg(header.ext_size - used, in.cur);
+    return ParseError::OK;
+}
+
+}  // namespace
 
 bool IsBitSet(char chr, size_t bit) {
     return ((chr >> bit) & 1) == 1;
 }
 
-Header ReadHeader(std::ifstream& in) {
-    Header header;
-    in.read(header.file_id.data(), HEADER_FILE_ID_SIZE);
+ParseError DecodeHeader(const char* data, size_t size, Header& header) {
+    // A reused header must not keep flags or the CRC of the previous file
+    header = Header();
+    if (size < HEADER_FILE_ID_SIZE) {
+        return ParseError::TRUNCATED;
+    }
+    header.file_id.assign(data, HEADER_FILE_ID_SIZE);
     if (header.file_id != "ID3") {
-        std::cout << header.file_id << '\n';
-        std::cerr << "INCORRECT FILE\n";
-        exit(1);
+        return ParseError::NOT_ID3;
+    }
+    if (size < HEADER_SIZE) {
+        return ParseError::TRUNCATED;
     }
 
-    in.read(header.version.data(), HEADER_VERSION_SIZE);
+    header.version.assign(data + HEADER_FILE_ID_SIZE, HEADER_VERSION_SIZE);
 
-    char flags;
-    in.read(&flags, HEADER_FLAGS_SIZE);
+    char flags = data[HEADER_FILE_ID_SIZE + HEADER_VERSION_SIZE];
     if (IsBitSet(flags, 7)) header.unsync = true;
     if (IsBitSet(flags, 6)) header.ext_header = true;
     if (IsBitSet(flags, 5)) header.exp_ind = true;
     if (IsBitSet(flags, 4)) header.footer = true;
-    header.size = ReadSize(in);
+
+    // Size is a synchsafe integer, the highest bit of every byte is zero
+    const char* size_bytes = data + HEADER_FILE_ID_SIZE + HEADER_VERSION_SIZE + HEADER_FLAGS_SIZE;
+    header.size = 0;
+    for (size_t i = 0; i < 4; ++i) {
+        if (IsBitSet(size_bytes[i], 7)) {
+            return ParseError::BAD_SIZE;
+        }
+        header.size = header.size << 7 | size_bytes[i];
+    }
+    return ParseError::OK;
+}
+
+ParseError ReadHeader(std::istream& in, Header& header) {
+    char data[HEADER_SIZE];
+    in.read(data, HEADER_SIZE);
+    ParseError error = DecodeHeader(data, in.gcount(), header);
+    if (error != ParseError::OK) {
+        return error;
+    }
 
     if(header.ext_header){
-        size_t a = ReadSize(in);
-        in.seekg(a - 4, in.cur);
+        if (header.size < 4) {
+            return ParseError::BAD_SIZE;
+        }
+        error = header.version[0] == 0x03 ? ReadExtendedHeaderV3(in, header) : ReadExtendedHeaderV4(in, header);
+        if (error != ParseError::OK) {
+            return error;
+        }
     }
-    return header;
+    return in ? ParseError::OK : ParseError::TRUNCATED;
 }
 
-size_t ReadSize(std::ifstream& in) {
-    std::string size(4, ' ');
-    in.read(size.data(), size.size());
+AudioRange GetAudioRange(std::istream& in) {
+    AudioRange range;
+    in.seekg(0, std::ios::end);
+    range.end = in.tellg();
 
-    return size[0] << 21 | size[1] << 14 | size[2] << 7 | size[3];
+    // Only the bounds of the tag are needed, the extended header is inside them
+    char data[HEADER_SIZE];
+    Header header;
+    in.seekg(0, std::ios::beg);
+    in.read(data, HEADER_SIZE);
+    range.error = DecodeHeader(data, in.gcount(), header);
+    if (range.error == ParseError::OK) {
+        range.begin = HEADER_SIZE + header.size + (header.footer ? FOOTER_SIZE : 0);
+    } else if (range.error == ParseError::NOT_ID3 || in.gcount() < HEADER_FILE_ID_SIZE) {
+        range.error = ParseError::OK;
+    } else {
+        in.clear();
+        return range;
+    }
+    if (range.begin > range.end) {
+        range.error = ParseError::TRUNCATED;
+    }
+
+    std::string id(HEADER_FILE_ID_SIZE, ' ');
+
+    if (range.end >= range.begin + ID3V1_SIZE) {
+        in.clear();
+        in.seekg(range.end - ID3V1_SIZE, std::ios::beg);
+        in.read(id.data(), id.size());
+        if (in && id == "TAG") {
+            range.end -= ID3V1_SIZE;
+        }
+    }
+
+    // Tag appended to the end of the file is located by its footer
+    if (range.end >= range.begin + HEADER_SIZE + FOOTER_SIZE) {
+        in.clear();
+        in.seekg(range.end - FOOTER_SIZE, std::ios::beg);
+        in.read(id.data(), id.size());
+        if (in && id == "3DI") {
+            in.seekg(HEADER_VERSION_SIZE + HEADER_FLAGS_SIZE, in.cur);
+            size_t size = ReadSize(in);
+            if (size <= range.end - range.begin - HEADER_SIZE - FOOTER_SIZE) {
+                range.end -= HEADER_SIZE + size + FOOTER_SIZE;
+            }
+        }
+    }
+
+    range.end = std::max(range.begin, range.end);
+    in.clear();
+    return range;
+}
+
+size_t ReadSize(std::istream& in) {
+    unsigned char bytes[4] = {};
+    in.read(reinterpret_cast<char*>(bytes), sizeof(bytes));
+
+    size_t size = 0;
+    for (unsigned char byte : bytes) {
+        if (byte & 0x80) {
+            return INVALID_SIZE;
+        }
+        size = size << 7 | byte;
+    }
+    return size;
+}
+
+size_t ReadFrameSize(std::istream& in) {
+    return synchsafe_frame_sizes ? ReadSize(in) : ReadBigEndian(in);
 }
 
-std::string ReadDataToZeroByte(std::ifstream& in, size_t encoding) {
+std::string ReadDataToZeroByte(std::istream& in, size_t encoding) {
     std::string data;
     char byte;
     while (in.read(&byte, 1)) {
@@ -52,33 +226,179 @@ std::string ReadDataToZeroByte(std::ifstream& in, size_t encoding) {
     return data;
 }
 
+std::string ReadToTerminator(std::istream& in, char encoding) {
+    std::string data;
+    if (encoding == 0x01 || encoding == 0x02) {
+        char pair[2];
+        while (in.read(pair, 2)) {
+            if (pair[0] == 0x00 && pair[1] == 0x00) break;
+            data.append(pair, 2);
+        }
+    } else {
+        std::getline(in, data, '\0');
+    }
+    return data;
+}
+
+size_t TerminatorSize(char encoding) {
+    return encoding == 0x01 || encoding == 0x02 ? 2 : 1;
+}
+
+void TrimTerminator(char encoding, std::string& text) {
+    size_t unit = TerminatorSize(encoding);
+    if (text.size() >= unit && text.find_first_not_of('\0', text.size() - unit) == std::string::npos) {
+        text.resize(text.size() - unit);
+    }
+}
+
 std::ostream& operator<<(std::ostream& out, const Frame& frame) {
     out << "\n";
+    if (frame.in_file) {
+        out << "This is: " << frame.type << '\n';
+        out << "Content: " << frame.size << " bytes at " << frame.content_offset << ", kept in the file\n\n";
+        return out;
+    }
     frame.Print(out);
     return out;
 }
 
-std::ifstream& operator>>(std::ifstream& in, Frame& frame) {
+std::istream& operator>>(std::istream& in, Frame& frame) {
+    if (frame.size > FrameBudget() && frame.LoadsContent()) {
+        frame.in_file = true;
+        frame.content_offset = in.tellg();
+        in.seekg(frame.size, in.cur);
+        if (!in) {
+            frame.error = ParseError::TRUNCATED;
+        }
+        return in;
+    }
     frame.Read(in);
     return in;
 }
 
-void Parse(const std::string& file) {
-    std::ifstream in( file, std::ios::binary);
+void SetFrameBudget(size_t bytes) {
+    frame_budget = bytes;
+}
+
+size_t FrameBudget() {
+    return frame_budget;
+}
 
+ParseError ReadContent(const std::string& file, const Frame& frame,
+                       const std::function<bool(const char*, size_t)>& consumer) {
+    std::ifstream in(file, std::ios::binary);
     if (!in.is_open()) {
-        std::cerr << "No such file to open\n";
-        exit(-1);
+        return ParseError::CANT_OPEN;
     }
+    in.seekg(frame.ContentOffset());
 
-    Header header = ReadHeader(in);
+    std::string chunk(std::min(FRAME_CHUNK_SIZE, frame.ContentSize()), '\0');
+    for (size_t left = frame.ContentSize(); left > 0;) {
+        size_t length = std::min(chunk.size(), left);
+        if (!in.read(chunk.data(), length)) {
+            return ParseError::TRUNCATED;
+        }
+        left -= length;
+        if (!consumer(chunk.data(), length)) {
+            break;
+        }
+    }
+    return ParseError::OK;
+}
 
+Frame* CreateFrame(const std::string& frame_id, std::istream& in, const std::string& file) {
     Frame* frame;
+    if (frame_id == "TXXX") {
+        frame = new TXXXFrame(in);
+    } else if (frame_id[0] == 'T') {
+        frame = new TextFrame(in);
+    } else if (frame_id == "COMM") {
+        frame = new CommentFrame(in);
+    } else if (frame_id == "POPM") {
+        frame = new PopularimeterFrame(in);
+    } else  if (frame_id == "USLT") {
+        frame = new TranscriptionFrame(in);
+    } else if (frame_id == "WXXX") {
+        frame = new WXXXrame(in);
+    } else if (frame_id[0] == 'W') {
+        frame = new URLFrame(in);
+    } else if (frame_id == "PCNT") {
+        frame = new PlayCounterFrame(in);
+    } else if (frame_id == "PRIV") {
+        frame = new PrivateFrame(in);
+    } else if (frame_id == "GRID") {
+        frame = new GroupIdFrame(in);
+    } else if (frame_id == "ETCO") {
+        frame = new ETCOFrame(in);
+    } else if (frame_id == "SYLT") {
+        frame = new SYLTFrame(in);
+    } else if (frame_id == "COMR") {
+        frame = new COMRFrame(in, file);
+    } else if (frame_id == "ENCR") {
+        frame = new ENCRFrame(in);
+    } else if (frame_id == "EQU2") {
+        frame = new EQU2Frame(in);
+    } else if (frame_id == "LINK") {
+        frame = new LINKFrame(in);
+    } else if (frame_id == "OWNE") {
+        frame = new OWNEFrame(in);
+    } else if (frame_id == "POSS") {
+        frame = new POSSFrame(in);
+    } else if (frame_id == "RBUF") {
+        frame = new RBUFFrame(in);
+    } else if (frame_id == "RVA2") {
+        frame = new RVA2Frame(in);
+    } else if (frame_id == "SEEK") {
+        frame = new SEEKFrame(in);
+    } else if (frame_id == "UFID") {
+        frame = new UFIDFrame(in);
+    } else if (frame_id == "USER") {
+        frame = new USERFrame(in);
+    } else if (frame_id == "APIC") {
+        frame = new APICFrame(in);
+    } else if (frame_id == "CHAP") {
+        frame = new CHAPFrame(in, file);
+    } else if (frame_id == "CTOC") {
+        frame = new CTOCFrame(in, file);
+    } else {
+        return nullptr;
+    }
+
+    frame->frame_id = frame_id;
+    return frame;
+}
+
+ParseError ReadFrames(std::istream& in, const Header& header, const std::string& file,
+                      const std::function<void(Frame&)>& callback) {
+    return ReadFrameRange(in, header.size - header.ext_size, file, [&](std::unique_ptr<Frame>& frame) {
+        callback(*frame);
+    });
+}
+
+ParseError ReadFrameRange(std::istream& in, size_t frames_size, const std::string& file,
+                          const std::function<void(std::unique_ptr<Frame>&)>& callback,
+                          const std::function<void(const std::string&, size_t)>& skipped) {
+    // Frames embed frames only through CHAP and CTOC, deeper nesting is a crafted tag
+    thread_local size_t depth = 0;
+    if (depth >= MAX_FRAME_DEPTH) {
+        return ParseError::BAD_SIZE;
+    }
+    ++depth;
+    struct DepthGuard {
+        ~DepthGuard() {
+            --depth;
+        }
+    } depth_guard;
+
     size_t cur_byte = 0;
     size_t padding_size = 0;
-    while (cur_byte < header.size) {
+    while (cur_byte + HEADER_SIZE <= frames_size) {
+        std::streampos frame_begin = in.tellg();
         std::string frame_id(4, ' ');
         in.read(frame_id.data(), 4);
+        if (!in) {
+            return ParseError::TRUNCATED;
+        }
 
         if (frame_id[0] == 0x00) {
             padding_size += 4;
@@ -87,87 +407,176 @@ void Parse(const std::string& file) {
                 if (byte != 0x00) break;
                 padding_size++;
             }
+            in.clear();
             in.seekg(-1, in.cur);
             break;
         }
 
-        if (frame_id == "TXXX") {
-            frame = new TXXXFrame(in);
-        } else if (frame_id[0] == 'T') {
-            frame = new TextFrame(in);
-        } else if (frame_id == "COMM") {
-            frame = new CommentFrame(in);
-        } else if (frame_id == "POPM") {
-            frame = new PopularimeterFrame(in);
-        } else  if (frame_id == "USLT") {
-            frame = new TranscriptionFrame(in);
-        } else if (frame_id == "WXXX") {
-            frame = new WXXXrame(in);
-        } else if (frame_id[0] == 'W') {
-            frame = new URLFrame(in);
-        } else if (frame_id == "PCNT") {
-            frame = new PlayCounterFrame(in);
-        } else if (frame_id == "PRIV") {
-            frame = new PrivateFrame(in);
-        } else if (frame_id == "GRID") {
-            frame = new GroupIdFrame(in);
-        } else if (frame_id == "ETCO") {
-            frame = new ETCOFrame(in);
-        } else if (frame_id == "SYLT") {
-            frame = new SYLTFrame(in);
-        } else if (frame_id == "COMR") {
-            frame = new COMRFrame(in, file);
-        } else if (frame_id == "ENCR") {
-            frame = new ENCRFrame(in);
-        } else if (frame_id == "EQU2") {
-            frame = new EQU2Frame(in);
-        } else if (frame_id == "LINK") {
-            frame = new LINKFrame(in);
-        } else if (frame_id == "OWNE") {
-            frame = new OWNEFrame(in);
-        } else if (frame_id == "POSS") {
-            frame = new POSSFrame(in);
-        } else if (frame_id == "RBUF") {
-            frame = new RBUFFrame(in);
-        } else if (frame_id == "RVA2") {
-            frame = new RVA2Frame(in);
-        } else if (frame_id == "SEEK") {
-            frame = new SEEKFrame(in);
-        } else if (frame_id == "UFID") {
-            frame = new UFIDFrame(in);
-        } else if (frame_id == "USER") {
-            frame = new USERFrame(in);
-        } else {
-            std::cout << "Didn't understand \"" << frame_id << "\" frame\n";
-            break;
+        // Declared before the frame, so its destruction is counted too
+        FrameAllocScope profile_scope(frame_id);
+        std::unique_ptr<Frame> frame(CreateFrame(frame_id, in, file));
+        if (frame == nullptr) {
+            // Frames we can't decode are skipped by their declared size
+            size_t size = ReadFrameSize(in);
+            if (size > frames_size - cur_byte - HEADER_SIZE) {
+                return ParseError::BAD_SIZE;
+            }
+            if (skipped) {
+                skipped(frame_id, size + HEADER_SIZE);
+            }
+            cur_byte += size + HEADER_SIZE;
+            in.seekg(frame_begin + static_cast<std::streamoff>(size + HEADER_SIZE));
+            continue;
+        }
+
+        // The loop condition keeps room for the frame header, so this can't wrap
+        if (frame->ContentSize() > frames_size - cur_byte - HEADER_SIZE) {
+            return ParseError::BAD_SIZE;
         }
 
         in >> *frame;
-        std::cout << *frame;
-        cur_byte += frame->Size();
-        delete frame;
+        if (frame->Error() != ParseError::OK) {
+            return frame->Error();
+        }
+        if (!in) {
+            return ParseError::TRUNCATED;
+        }
+
+        // The callback may take the frame
+        size_t frame_size = frame->Size();
+        callback(frame);
+        cur_byte += frame_size;
+        in.seekg(frame_begin + static_cast<std::streamoff>(frame_size));
+    }
+
+    return ParseError::OK;
+}
+
+ParseError ParseFrames(const std::string& file, Header& header, const std::function<void(Frame&)>& callback,
+                       const std::function<void(const std::string&, size_t)>& skipped) {
+    return TakeFrames(file, header, [&](std::unique_ptr<Frame>& frame) {
+        callback(*frame);
+    }, skipped);
+}
+
+ParseError TakeFrames(const std::string& file, Header& header,
+                      const std::function<void(std::unique_ptr<Frame>&)>& callback,
+                      const std::function<void(const std::string&, size_t)>& skipped) {
+    FileAllocScope profile_scope(file);
+    std::ifstream in(file, std::ios::binary);
+    if (!in.is_open()) {
+        return ParseError::CANT_OPEN;
+    }
+
+    in.seekg(0, std::ios::end);
+    size_t file_size = in.tellg();
+    in.seekg(0, std::ios::beg);
+
+    ParseError error = ReadHeader(in, header);
+    if (error != ParseError::OK) {
+        return error;
+    }
+    if (HEADER_SIZE + header.size > file_size) {
+        return ParseError::TRUNCATED;
     }
 
+    // Sub-frames of CHAP and CTOC are sized like the frames of their tag
+    struct SizeGuard {
+        ~SizeGuard() {
+            synchsafe_frame_sizes = true;
+        }
+    } size_guard;
+    synchsafe_frame_sizes = header.version[0] != 0x03;
+
+    size_t frames_size = header.size - header.ext_size;
+    if (header.crc_present && frames_size <= FrameBudget()) {
+        // The CRC needs every byte anyway, so small tags with one are read once,
+        // then checked and decoded from memory. Others are read frame by frame.
+        std::streamoff frames_offset = in.tellg();
+        std::string frames(frames_size, '\0');
+        if (!in.read(frames.data(), frames_size)) {
+            return ParseError::TRUNCATED;
+        }
+        if (header.crc_present && Crc32(frames.data(), frames_size - header.padding) != header.crc) {
+            return ParseError::BAD_CRC;
+        }
+        MemoryBuffer buffer(frames.data(), frames.size(), frames_offset);
+        std::istream memory(&buffer);
+        return ReadFrameRange(memory, frames_size, file, callback, skipped);
+    }
+
+    if (header.crc_present) {
+        // Checked in chunks before decoding, so a large tag is never held in memory as a whole
+        std::streampos frames_begin = in.tellg();
+        std::string chunk(FRAME_CHUNK_SIZE, '\0');
+        uint32_t crc = 0;
+        for (size_t left = frames_size - header.padding; left > 0;) {
+            size_t length = std::min(chunk.size(), left);
+            if (!in.read(chunk.data(), length)) {
+                return ParseError::TRUNCATED;
+            }
+            crc = Crc32(chunk.data(), length, crc);
+            left -= length;
+        }
+        if (crc != header.crc) {
+            return ParseError::BAD_CRC;
+        }
+        in.seekg(frames_begin);
+    }
+
+    return ReadFrameRange(in, frames_size, file, callback, skipped);
+}
+
+ParseError Parse(const std::string& file) {
+    Header header;
+    ParseError error = ParseFrames(file, header, [](Frame& frame) {
+        std::cout << frame;
+    });
+    if (error != ParseError::OK) {
+        std::cerr << file << ": " << ErrorToText(error) << '\n';
+        return error;
+    }
+
+    std::ifstream in(file, std::ios::binary);
     in.seekg(-10, std::ios::end);
     std::string footer_id(3, ' ');
     in.read(footer_id.data(), 3);
     if (footer_id == "3DI") {
         std::cout << "Here is footer\n";
     }
+    return error;
+}
+
+ParseError ParseInterned(const std::string& file, StringPool& pool, std::vector<InternedField>& fields) {
+    Header header;
+    ParseError error = ParseFrames(file, header, [&](Frame& frame) {
+        frame.Intern(pool, fields);
+    }, [&](const std::string& frame_id, size_t) {
+        fields.push_back({pool.Intern(frame_id), 0, 0, 0});
+    });
+
+    fields.shrink_to_fit();
+    return error;
 }
 
-void ReadData(char encoding, std::ifstream& in, std::string& data) {
+bool ReadData(char encoding, std::istream& in, std::string& data) {
     size_t size = data.size();
 
     if (encoding == 0x01 || encoding == 0x02) {
         if (encoding == 0x01) {
+            if (size < 2) {
+                return false;
+            }
             in.seekg(2, std::ios::cur);
             size -= 2;
         }
 
         std::u16string u16(size / 2 + 1, '\0');
         in.read((char*)&u16[0], size);
-        data = std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t>{}.to_bytes(u16);
+        // Converter with an error string returns it instead of throwing on malformed input
+        std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t> converter(ENCODING_ERROR);
+        data = converter.to_bytes(u16);
+        return data != ENCODING_ERROR;
     } else {
         in.read(data.data(), size);
     }
@@ -175,6 +584,46 @@ void ReadData(char encoding, std::ifstream& in, std::string& data) {
     if (encoding == 0x00) {
         data =  ISO_8859_TO_UTF_8(data);
     }
+    return true;
+}
+
+bool DecodeText(char encoding, std::string& text) {
+    if (encoding == 0x00) {
+        text = ISO_8859_TO_UTF_8(text);
+        return true;
+    }
+    if (encoding == 0x03) {
+        return true;
+    }
+    if ((encoding != 0x01 && encoding != 0x02) || text.size() % 2 != 0) {
+        return false;
+    }
+
+    // $01 starts with a byte order mark, $02 is always big-endian
+    size_t begin = 0;
+    bool big_endian = encoding == 0x02;
+    if (encoding == 0x01 && text.size() >= 2) {
+        if (text[0] == '\xFE' && text[1] == '\xFF') {
+            big_endian = true;
+            begin = 2;
+        } else if (text[0] == '\xFF' && text[1] == '\xFE') {
+            begin = 2;
+        }
+    }
+
+    std::u16string u16;
+    u16.reserve((text.size() - begin) / 2);
+    for (size_t i = begin; i < text.size(); i += 2) {
+        unsigned char first = text[i];
+        unsigned char second = text[i + 1];
+        u16.push_back(big_endian ? first << 8 | second : second << 8 | first);
+    }
+
+    // Converter with an error string returns it instead of throwing on malformed input
+    std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t> converter(ENCODING_ERROR);
+    text = converter.to_bytes(u16);
+    // A surrogate cut off at the end is left unconverted instead
+    return text != ENCODING_ERROR && converter.converted() == u16.size();
 }
 
 
@@ -192,7 +641,7 @@ std::string ISO_8859_TO_UTF_8(const std::string &str) {
     return res;
 }
 
-uint32_t GetTime(std::ifstream& in) {
+uint32_t GetTime(std::istream& in) {
     char byte;
     uint32_t time = 0;
     for (int i = 0; i < 4; ++i) {
@@ -221,3 +670,25 @@ std::string EncodingToText(size_t encoding) {
     }
 }
 
+std::string ErrorToText(ParseError error) {
+    switch (error) {
+        case ParseError::OK:
+            return "OK";
+        case ParseError::CANT_OPEN:
+            return "No such file to open";
+        case ParseError::NOT_ID3:
+            return "File doesn't start with ID3v2 tag";
+        case ParseError::TRUNCATED:
+            return "File ends before the end of the tag";
+        case ParseError::BAD_SIZE:
+            return "Tag or frame size doesn't match its content";
+        case ParseError::BAD_ENCODING:
+            return "Incorrect text encoding";
+        case ParseError::BAD_CRC:
+            return "Tag data doesn't match its CRC-32";
+        case ParseError::WRITE_FAILED:
+            return "Can't write output file";
+        default:
+            return "Unknown error";
+    }
+}
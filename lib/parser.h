@@ -1,11 +1,15 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <iostream>
 #include <fstream>
 #include <codecvt>
 #include <vector>
 #include <cstdint>
 #include <locale>
+#include <functional>
+#include <memory>
+#include "string_pool.h"
 
 const uint8_t HEADER_FLAGS_SIZE = 1;
 const uint8_t ENCODING_SIZE = 1;
@@ -15,9 +19,22 @@ const uint8_t HEADER_FILE_ID_SIZE = 3;
 const uint8_t LANGUAGE_SIZE = 3;
 const uint8_t FRAME_ID_SIZE = 4;
 const uint8_t DATE_SIZE = 8;
+const uint8_t HEADER_SIZE = 10;
+const uint8_t FOOTER_SIZE = 10;
+const uint8_t ID3V1_SIZE = 128;
+const int NO_ENCODING = -1;
+const size_t MAX_FRAME_DEPTH = 4;
+// Frames with more content than the budget aren't loaded, see SetFrameBudget
+const size_t DEFAULT_FRAME_BUDGET = 16 << 20;
+const size_t FRAME_CHUNK_SIZE = 64 << 10;
+const uint32_t NO_CHAPTER_OFFSET = 0xFFFFFFFF;
+// ReadSize result for bytes that aren't synchsafe, larger than any tag
+const size_t INVALID_SIZE = SIZE_MAX;
 
 struct Header {
-    Header() : unsync(false), ext_header(false), exp_ind(false), footer(false), size(0) {
+    Header() : unsync(false), ext_header(false), exp_ind(false), footer(false), size(0),
+               ext_size(0), padding(0), update(false), crc_present(false), crc(0), restricted(false),
+               restrictions(0) {
         file_id.resize(HEADER_FILE_ID_SIZE);
         version.resize(HEADER_VERSION_SIZE);
     }
@@ -29,19 +46,153 @@ struct Header {
     bool exp_ind;
     bool footer;
     size_t size;
+
+    // Extended header, ext_size counts all of its bytes in both versions
+    size_t ext_size;
+    // Padding declared by a v2.3 extended header, the CRC doesn't cover it
+    size_t padding;
+    bool update;
+    bool crc_present;
+    uint32_t crc;
+    bool restricted;
+    char restrictions;
+};
+
+// Read-only stream buffer over memory, lets frames be decoded from a buffer in place
+// `origin` is the file offset of the first byte, stream positions are file offsets.
+class MemoryBuffer : public std::streambuf {
+public:
+    MemoryBuffer(const char* data, size_t size, size_t origin = 0) : origin(origin) {
+        char* begin = const_cast<char*>(data);
+        setg(begin, begin, begin + size);
+    }
+
+protected:
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode) override {
+        off_type base = dir == std::ios_base::beg ? -origin : (dir == std::ios_base::cur ? gptr() - eback() : egptr() - eback());
+        if (base + off < 0 || base + off > egptr() - eback()) {
+            return pos_type(off_type(-1));
+        }
+        setg(eback(), eback() + base + off, egptr());
+        return pos_type(origin + base + off);
+    }
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+        return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+
+private:
+    off_type origin;
+};
+
+enum class ParseError {
+    OK,
+    CANT_OPEN,
+    NOT_ID3,
+    TRUNCATED,
+    BAD_SIZE,
+    BAD_ENCODING,
+    BAD_CRC,
+    WRITE_FAILED
 };
 
-void Parse(const std::string& file);
+// Byte range of the audio payload: everything between the ID3v2 tag (with its footer)
+// at the start of the file and an appended ID3v2 tag and/or ID3v1 tag at the end.
+// error is set when the file starts with a tag that can't be decoded or doesn't fit in the file.
+struct AudioRange {
+    size_t begin = 0;
+    size_t end = 0;
+    ParseError error = ParseError::OK;
+};
+
+// Compact form of a frame with all strings interned in a StringPool.
+// key is a language code, owner ID or e-mail; desc is a content descriptor.
+struct FrameField {
+    std::string_view key;
+    std::string_view desc;
+    std::string_view value;
+};
+
+struct InternedField {
+    uint32_t frame_id = 0;
+    uint32_t key = 0;
+    uint32_t desc = 0;
+    uint32_t value = 0;
+};
+
+class Frame;
+
+ParseError Parse(const std::string& file);
+
+// Opens the file, checks the header and passes every decoded frame to the callback.
+// Never exits and never allocates more than the file can hold: broken files
+// are reported with an error code and the caller goes on with the next one.
+// Frames of unknown IDs are skipped, `skipped` gets their ID and size with the frame header.
+ParseError ParseFrames(const std::string& file, Header& header, const std::function<void(Frame&)>& callback,
+                       const std::function<void(const std::string&, size_t)>& skipped = nullptr);
+
+// Same as ParseFrames, but the callback may keep the frame
+ParseError TakeFrames(const std::string& file, Header& header,
+                      const std::function<void(std::unique_ptr<Frame>&)>& callback,
+                      const std::function<void(const std::string&, size_t)>& skipped = nullptr);
+
+// Interned fields of every frame, frames without fields and skipped frames are kept by their ID alone
+ParseError ParseInterned(const std::string& file, StringPool& pool, std::vector<InternedField>& fields);
+
+Frame* CreateFrame(const std::string& frame_id, std::istream& in, const std::string& file);
+
+ParseError ReadFrames(std::istream& in, const Header& header, const std::string& file,
+                      const std::function<void(Frame&)>& callback);
+
+// Reads frames from the next `frames_size` bytes (the frames area of a tag or the
+// sub-frames of CHAP and CTOC), the callback owns the frame it is given
+ParseError ReadFrameRange(std::istream& in, size_t frames_size, const std::string& file,
+                          const std::function<void(std::unique_ptr<Frame>&)>& callback,
+                          const std::function<void(const std::string&, size_t)>& skipped = nullptr);
+
+bool ReadData(char encoding, std::istream& in, std::string& data);
 
-void ReadData(char encoding, std::ifstream& in, std::string& data);
+// Converts raw text of the encoding to UTF-8 in place, without its terminator.
+// The byte order mark of UTF-16 is removed. False if the text isn't valid in the encoding.
+bool DecodeText(char encoding, std::string& text);
 
-Header ReadHeader(std::ifstream& in);
+// Decodes the 10-byte tag header, doesn't touch the extended header
+ParseError DecodeHeader(const char* data, size_t size, Header& header);
 
-size_t ReadSize(std::ifstream& in);
+ParseError ReadHeader(std::istream& in, Header& header);
 
-uint32_t GetTime(std::ifstream& in);
+// Largest frame content decoded into memory, for all threads. Larger frames are
+// returned undecoded with InFile() set, their content can be read with ReadContent.
+void SetFrameBudget(size_t bytes);
 
-std::string ReadDataToZeroByte(std::ifstream& in, size_t encoding);
+size_t FrameBudget();
+
+// Passes the content of a frame kept in the file to the consumer in FRAME_CHUNK_SIZE
+// chunks through one buffer. The consumer returns false to stop.
+ParseError ReadContent(const std::string& file, const Frame& frame,
+                       const std::function<bool(const char*, size_t)>& consumer);
+
+AudioRange GetAudioRange(std::istream& in);
+
+// Synchsafe integer of 4 bytes, INVALID_SIZE if a byte has its highest bit set
+size_t ReadSize(std::istream& in);
+
+// Size of a frame in the tag being decoded: synchsafe in v2.4, plain 32-bit big-endian in v2.3
+size_t ReadFrameSize(std::istream& in);
+
+uint32_t GetTime(std::istream& in);
+
+std::string ReadDataToZeroByte(std::istream& in, size_t encoding);
+
+// Reads up to the terminator of the encoding ($00 00 on a 2-byte boundary for UTF-16),
+// the terminator is consumed but not returned, the text isn't converted
+std::string ReadToTerminator(std::istream& in, char encoding);
+
+// Size of the terminator of the encoding, 2 for UTF-16
+size_t TerminatorSize(char encoding);
+
+// Removes the terminator the text may end with, before it is decoded
+void TrimTerminator(char encoding, std::string& text);
 
 std::string ISO_8859_TO_UTF_8(const std::string& str);
 
@@ -49,6 +200,31 @@ bool IsBitSet(char chr, size_t bit);
 
 std::string EncodingToText(size_t encoding);
 
+std::string ErrorToText(ParseError error);
+
+// Play counters are big-endian and may grow past 32 bits, values beyond 64 bits saturate
+inline uint64_t ReadCounter(const std::string& bytes) {
+    uint64_t counter = 0;
+    for (char byte : bytes) {
+        if (counter >> 56) {
+            return UINT64_MAX;
+        }
+        counter = (counter << 8) | static_cast<unsigned char>(byte);
+    }
+    return counter;
+}
+
+inline std::string PictureTypeToText(size_t picture_type) {
+    static const char* const types[] = {
+        "Other", "32x32 pixels 'file icon' (PNG only)", "Other file icon", "Cover (front)", "Cover (back)",
+        "Leaflet page", "Media (e.g. label side of CD)", "Lead artist/lead performer/soloist",
+        "Artist/performer", "Conductor", "Band/Orchestra", "Composer", "Lyricist/text writer",
+        "Recording Location", "During recording", "During performance", "Movie/video screen capture",
+        "A bright coloured fish", "Illustration", "Band/artist logotype", "Publisher/Studio logotype",
+    };
+    return picture_type < sizeof(types) / sizeof(types[0]) ? types[picture_type] : "unknown picture type";
+}
+
 inline std::string EventToDescription(size_t event) {
     switch (event) {
         case 0x00:
@@ -121,7 +297,7 @@ inline std::string EventToDescription(size_t event) {
 
 class Frame {
 public:
-    Frame(std::ifstream& in) : size(ReadSize(in)) {
+    Frame(std::istream& in) : size(ReadFrameSize(in)) {
         flags.resize(FLAGS_SIZE);
         in.read(flags.data(), flags.size());
     }
@@ -131,28 +307,126 @@ public:
     size_t Size() const {
         return size + 10;
     }
-    friend std::ifstream& operator>>(std::ifstream& in, Frame& frame);
+
+    const std::string& Id() const {
+        return frame_id;
+    }
+
+    ParseError Error() const {
+        return error;
+    }
+
+    // Text encoding byte of the frame, NO_ENCODING for frames without text
+    virtual int Encoding() const {
+        return NO_ENCODING;
+    }
+
+    // The frame is over the budget: nothing is decoded, the content stays in the file
+    bool InFile() const {
+        return in_file;
+    }
+
+    // File offset and size of the content of a frame kept in the file
+    size_t ContentOffset() const {
+        return content_offset;
+    }
+
+    size_t ContentSize() const {
+        return size;
+    }
+
+    // Appends the text of the frame as views into the frame, frames without text append nothing
+    virtual void Fields(std::vector<FrameField>&) const {}
+
+    // Appends interned representation of the fields, a frame without fields adds its ID alone
+    void Intern(StringPool& pool, std::vector<InternedField>& fields) const {
+        thread_local std::vector<FrameField> text;
+        text.clear();
+        Fields(text);
+        uint32_t interned_id = pool.Intern(frame_id);
+        if (text.empty()) {
+            fields.push_back({interned_id, 0, 0, 0});
+        }
+        for (const auto& field : text) {
+            fields.push_back({interned_id, pool.Intern(field.key), pool.Intern(field.desc), pool.Intern(field.value)});
+        }
+    }
+
+    friend std::istream& operator>>(std::istream& in, Frame& frame);
     friend std::ostream& operator<<(std::ostream& out, const Frame& frame);
+    friend Frame* CreateFrame(const std::string& frame_id, std::istream& in, const std::string& file);
 protected:
-    virtual void Read(std::ifstream& in) = 0;
+    virtual void Read(std::istream& in) = 0;
     virtual void Print(std::ostream& out) const = 0;
+
+    // Frames that don't copy their content into memory decode at any size
+    virtual bool LoadsContent() const {
+        return true;
+    }
+
+    // Checks that `used` bytes of data fit into the frame, otherwise marks the frame as broken
+    bool Fits(size_t used) {
+        if (used > size) {
+            error = ParseError::BAD_SIZE;
+            return false;
+        }
+        return true;
+    }
+
+    char ReadEncoding(std::istream& in) {
+        char encoding = in.get();
+        if (encoding < 0x00 || encoding > 0x03) {
+            error = ParseError::BAD_ENCODING;
+        }
+        return encoding;
+    }
+
+    ParseError error = ParseError::OK;
+    std::string frame_id;
     std::string type;
     std::string flags;
     size_t size;
+    bool in_file = false;
+    size_t content_offset = 0;
 };
 
-std::ifstream& operator>>(std::ifstream& in, Frame& frame);
+std::istream& operator>>(std::istream& in, Frame& frame);
 
 std::ostream& operator<<(std::ostream& out, const Frame& frame);
 
 
 class LanguageFrame : public Frame {
 public:
-    LanguageFrame(std::ifstream& in) : Frame(in) {
+    LanguageFrame(std::istream& in) : Frame(in) {
         language.resize(LANGUAGE_SIZE);
     }
+
+    void Fields(std::vector<FrameField>& fields) const override {
+        fields.push_back({language, desc, data});
+    }
+
+    int Encoding() const override {
+        return static_cast<unsigned char>(encoding);
+    }
 protected:
-    char encoding;
+    // Encoding, language, description and text of COMM and USLT.
+    // Description and text are decoded to UTF-8 without their terminators.
+    void ReadLanguageText(std::istream& in) {
+        encoding = ReadEncoding(in);
+        in.read(language.data(), language.size());
+        desc = ReadToTerminator(in, encoding);
+        size_t used = ENCODING_SIZE + language.size() + desc.size() + TerminatorSize(encoding);
+        if (!Fits(used)) return;
+        data.resize(size - used);
+        in.read(data.data(), data.size());
+
+        TrimTerminator(encoding, data);
+        if (!DecodeText(encoding, desc) || !DecodeText(encoding, data)) {
+            error = ParseError::BAD_ENCODING;
+        }
+    }
+
+    char encoding = 0;
     std::string language;
     std::string desc;
     std::string data;
@@ -160,37 +434,50 @@ protected:
 
 class TextFrame: public Frame {
 public:
-    TextFrame(std::ifstream& in) : Frame(in) {
+    TextFrame(std::istream& in) : Frame(in) {
         type = "Text Frame";
     }
 
-protected:
-    void Read(std::ifstream& in) override {
-        encoding = in.get();
-        if (encoding == 0x01) {
-            in.seekg(ENCODING_SIZE, in.cur);
+    void Fields(std::vector<FrameField>& fields) const override {
+        for (const auto& i : data) {
+            fields.push_back({{}, {}, i});
         }
+    }
 
-        size_t cur_byte = 1;
-        std::string cur;
-        while (cur_byte < size) {
-            cur += in.get();
-            cur_byte++;
-            if (encoding == 0x03) {
-                if (cur.size() >= 2 && cur.back() == 0x00 && cur[cur.size() - 2] == 0x00) {
-                    data.push_back(cur);
-                    cur.clear();
-                }
-            } else {
-                if (cur.back() == 0x00) {
-                    data.push_back(cur);
-                    cur.clear();
-                }
+    int Encoding() const override {
+        return static_cast<unsigned char>(encoding);
+    }
+
+    // Values in UTF-8 without their terminators
+    const std::vector<std::string>& Values() const {
+        return data;
+    }
+
+protected:
+    void Read(std::istream& in) override {
+        encoding = ReadEncoding(in);
+        if (!Fits(ENCODING_SIZE)) return;
+        std::string text(size - ENCODING_SIZE, '\0');
+        in.read(text.data(), text.size());
+
+        // Strings end with $00, or $00 00 on a 2-byte boundary for UTF-16
+        size_t unit = TerminatorSize(encoding);
+        size_t begin = 0;
+        for (size_t i = 0; i + unit <= text.size(); i += unit) {
+            if (text[i] == 0x00 && text[i + unit - 1] == 0x00) {
+                data.push_back(text.substr(begin, i - begin));
+                begin = i + unit;
             }
         }
+        if (begin < text.size()) {
+            data.push_back(text.substr(begin));
+        }
 
-        if (cur.size() != 0) {
-            data.push_back(cur);
+        for (auto& value : data) {
+            if (!DecodeText(encoding, value)) {
+                error = ParseError::BAD_ENCODING;
+                return;
+            }
         }
     }
 
@@ -205,19 +492,32 @@ protected:
         std::cout << '\n';
     }
 
-    char encoding;
+    char encoding = 0;
     std::vector<std::string> data;
 };
 
 class TXXXFrame: public TextFrame {
 public:
-    TXXXFrame(std::ifstream& in) : TextFrame(in) {}
+    TXXXFrame(std::istream& in) : TextFrame(in) {}
+
+    void Fields(std::vector<FrameField>& fields) const override {
+        if (!data.empty()) {
+            fields.push_back({{}, data[0], value});
+        }
+    }
 private:
-    void Read(std::ifstream& in) override {
-        encoding = in.get();
-        data.push_back(ReadDataToZeroByte(in, 0x03));
-        value.resize(size - 1 - data[0].size() - 1);
+    void Read(std::istream& in) override {
+        encoding = ReadEncoding(in);
+        data.push_back(ReadToTerminator(in, encoding));
+        size_t used = ENCODING_SIZE + data[0].size() + TerminatorSize(encoding);
+        if (!Fits(used)) return;
+        value.resize(size - used);
         in.read(value.data(), value.size());
+
+        TrimTerminator(encoding, value);
+        if (!DecodeText(encoding, data[0]) || !DecodeText(encoding, value)) {
+            error = ParseError::BAD_ENCODING;
+        }
     }
 
     void Print(std::ostream& out) const override {
@@ -234,17 +534,13 @@ private:
 
 class CommentFrame: public LanguageFrame {
 public:
-    CommentFrame(std::ifstream& in) : LanguageFrame(in) {
+    CommentFrame(std::istream& in) : LanguageFrame(in) {
         type = "Comment Frame";
     }
 
 private:
-    void Read(std::ifstream& in) override {
-        encoding = in.get();
-        in.read(language.data(), language.size());
-        desc = ReadDataToZeroByte(in, encoding);
-        data.resize(size - ENCODING_SIZE - language.size() - desc.size() - 1);
-        ReadData(encoding, in, data);
+    void Read(std::istream& in) override {
+        ReadLanguageText(in);
     }
 
     void Print(std::ostream& out) const override  {
@@ -259,14 +555,27 @@ private:
 
 class PopularimeterFrame: public Frame {
 public:
-    PopularimeterFrame(std::ifstream& in) : Frame(in) {
+    PopularimeterFrame(std::istream& in) : Frame(in) {
         type = "Popularimeter Frame";
     }
 
+    void Fields(std::vector<FrameField>& fields) const override {
+        fields.push_back({email, {}, {}});
+    }
+
+    uint8_t Rating() const {
+        return rating;
+    }
+
+    uint64_t Counter() const {
+        return ReadCounter(counter);
+    }
+
 private:
-    void Read(std::ifstream& in) override {
+    void Read(std::istream& in) override {
         email = ReadDataToZeroByte(in, 0x03);
         rating = in.get();
+        if (!Fits(email.size() + 1 + 1)) return;
         counter.resize(size - email.size() - 1 - 1);
         in.read(counter.data(), counter.size());
     }
@@ -278,24 +587,20 @@ private:
         out << "Counter: " << counter << '\n' << '\n';
     }
 
-    char rating;
+    char rating = 0;
     std::string email;
     std::string counter;
 };
 
 class TranscriptionFrame: public LanguageFrame {
 public:
-    TranscriptionFrame(std::ifstream& in) : LanguageFrame(in) {
+    TranscriptionFrame(std::istream& in) : LanguageFrame(in) {
         type = "Transcription Frame";
     }
 
 private:
-    void Read(std::ifstream& in) override {
-        encoding = in.get();
-        in.read(language.data(), language.size());
-        desc = ReadDataToZeroByte(in, encoding);
-        data.resize(size - 1 - language.size() - desc.size() - 1);
-        ReadData(encoding, in, data);
+    void Read(std::istream& in) override {
+        ReadLanguageText(in);
     }
 
     void Print(std::ostream& out) const override  {
@@ -308,13 +613,13 @@ private:
 
 class URLFrame: public Frame {
 public:
-    URLFrame(std::ifstream& in) : Frame(in) {
-        url.resize(size);
+    URLFrame(std::istream& in) : Frame(in) {
         type = "URL Frame";
     }
 
 protected:
-    void Read(std::ifstream& in) override {
+    void Read(std::istream& in) override {
+        url.resize(size);
         in.read(url.data(), url.size());
     }
 
@@ -328,14 +633,19 @@ protected:
 
 class WXXXrame: public URLFrame {
 public:
-    WXXXrame(std::ifstream& in) : URLFrame(in) {
+    WXXXrame(std::istream& in) : URLFrame(in) {
         type = "URL Frame";
     }
 
+    int Encoding() const override {
+        return static_cast<unsigned char>(encoding);
+    }
+
 protected:
-    void Read(std::ifstream& in) override {
-        encoding = in.get();
+    void Read(std::istream& in) override {
+        encoding = ReadEncoding(in);
         desc = ReadDataToZeroByte(in, encoding);
+        if (!Fits(ENCODING_SIZE + desc.size() + 1)) return;
         url.resize(size - ENCODING_SIZE - desc.size() - 1);
         in.read(url.data(), url.size());
     }
@@ -346,19 +656,23 @@ protected:
         out << "Description: " << desc << '\n';
     }
 
-    char encoding;
+    char encoding = 0;
     std::string desc;
 };
 
 
 class PlayCounterFrame: public Frame {
 public:
-    PlayCounterFrame(std::ifstream& in) : Frame(in) {
+    PlayCounterFrame(std::istream& in) : Frame(in) {
         type = "Play Counter Frame";
     }
 
+    uint64_t Counter() const {
+        return ReadCounter(counter);
+    }
+
 private:
-    void Read(std::ifstream& in) override {
+    void Read(std::istream& in) override {
         counter.resize(size);
         in.read(counter.data(), size);
     }
@@ -374,13 +688,18 @@ private:
 
 class PrivateFrame: public Frame {
 public:
-    PrivateFrame(std::ifstream& in) : Frame(in) {
+    PrivateFrame(std::istream& in) : Frame(in) {
         type = "Private Frame";
     }
 
+    void Fields(std::vector<FrameField>& fields) const override {
+        fields.push_back({owner_id, {}, {}});
+    }
+
 private:
-    void Read(std::ifstream& in) override {
+    void Read(std::istream& in) override {
         owner_id = ReadDataToZeroByte(in, 0x03);
+        if (!Fits(owner_id.size() + 1)) return;
         private_data.resize(size - owner_id.size() - 1);
         in.read(private_data.data(), private_data.size());
     }
@@ -397,15 +716,20 @@ private:
 
 class GroupIdFrame: public Frame {
 public:
-    GroupIdFrame(std::ifstream& in) : Frame(in) {
+    GroupIdFrame(std::istream& in) : Frame(in) {
         type = "Group ID Frame";
     }
 
+    void Fields(std::vector<FrameField>& fields) const override {
+        fields.push_back({owner_id, {}, {}});
+    }
+
 private:
-    void Read(std::ifstream& in) override {
+    void Read(std::istream& in) override {
         owner_id = ReadDataToZeroByte(in, 0x03);
         group_symbol = in.get();
-        group_data.resize(size - owner_id.size() - 1);
+        if (!Fits(owner_id.size() + 1 + 1)) return;
+        group_data.resize(size - owner_id.size() - 1 - 1);
         in.read(group_data.data(), group_data.size());
     }
 
@@ -417,19 +741,27 @@ private:
     }
 
     std::string owner_id;
-    char group_symbol;
+    char group_symbol = 0;
     std::string group_data;
 };
 
 
 class ETCOFrame: public Frame {
 public:
-    ETCOFrame(std::ifstream& in) : Frame(in) {
+    ETCOFrame(std::istream& in) : Frame(in) {
         type = "ETCO Frame";
     }
 
+    char TimeStampFormat() const {
+        return time_stamp_format;
+    }
+
+    const std::vector<std::pair<char, uint32_t>>& Events() const {
+        return data;
+    }
+
 private:
-    void Read(std::ifstream& in) override {
+    void Read(std::istream& in) override {
         time_stamp_format = in.get();
 
         size_t cur_byte = 1;
@@ -440,6 +772,7 @@ private:
             cur_byte += 5;
             data.push_back({event, time});
         }
+        Fits(cur_byte);
     }
 
     void Print(std::ostream& out) const override  {
@@ -450,34 +783,47 @@ private:
         std::cout << '\n';
     }
 
-    char time_stamp_format;
+    char time_stamp_format = 0;
     std::vector<std::pair<char, uint32_t>> data;
 };
 
 class SYLTFrame: public LanguageFrame {
 public:
-    SYLTFrame(std::ifstream& in) : LanguageFrame(in) {
+    SYLTFrame(std::istream& in) : LanguageFrame(in) {
         type = "SYLT Frame";
     }
 
+    char TimeStampFormat() const {
+        return time_stamp_format;
+    }
+
+    const std::vector<std::pair<uint32_t, std::string>>& Lyrics() const {
+        return time_data;
+    }
+
 private:
-    void Read(std::ifstream& in) override {
-        encoding = in.get();
+    void Read(std::istream& in) override {
+        encoding = ReadEncoding(in);
         in.read(language.data(), language.size());
         time_stamp_format = in.get();
         content_type = in.get();
-        desc = ReadDataToZeroByte(in, 0x03);
 
-        size_t cur_byte = ENCODING_SIZE + LANGUAGE_SIZE + 1 + 1 + desc.size() + 1;
-        char byte;
+        // Every string ends with the terminator of the encoding and is converted to UTF-8
+        size_t unit = TerminatorSize(encoding);
+        desc = ReadToTerminator(in, encoding);
+        size_t cur_byte = ENCODING_SIZE + LANGUAGE_SIZE + 1 + 1 + desc.size() + unit;
+        bool valid = DecodeText(encoding, desc);
         while (cur_byte < size) {
-            std::string lyrics = ReadDataToZeroByte(in, 0x03);
+            std::string lyrics = ReadToTerminator(in, encoding);
             uint32_t time = GetTime(in);
+            cur_byte += lyrics.size() + unit + 4;
 
+            valid = DecodeText(encoding, lyrics) && valid;
             time_data.push_back({time, lyrics});
-            cur_byte += 4 + lyrics.size() + 1;
         }
-
+        if (Fits(cur_byte) && !valid) {
+            error = ParseError::BAD_ENCODING;
+        }
     }
 
     void Print(std::ostream& out) const override  {
@@ -490,22 +836,26 @@ private:
         std::cout << '\n';
     }
 
-    char time_stamp_format;
-    char content_type;
+    char time_stamp_format = 0;
+    char content_type = 0;
     std::vector<std::pair<uint32_t, std::string>> time_data;
 };
 
 
 class COMRFrame: public Frame {
 public:
-    COMRFrame(std::ifstream& in, const std::string& file_) : Frame(in) {
+    COMRFrame(std::istream& in, const std::string& file_) : Frame(in) {
         type = "COMR Frame";
         file = file_;
     }
 
+    int Encoding() const override {
+        return static_cast<unsigned char>(encoding);
+    }
+
 private:
-    void Read(std::ifstream& in) override {
-        encoding = in.get();
+    void Read(std::istream& in) override {
+        encoding = ReadEncoding(in);
         price = ReadDataToZeroByte(in, encoding);
         valid_until = ReadDataToZeroByte(in, encoding);
         contact = ReadDataToZeroByte(in, encoding);
@@ -514,11 +864,14 @@ private:
         desc = ReadDataToZeroByte(in, encoding);
         MIME = ReadDataToZeroByte(in, encoding);
 
+        size_t used = ENCODING_SIZE + price.size() + 1 + valid_until.size() + 1 +
+                      contact.size() + 1 + 1 + seller.size() + 1 + desc.size() + 1 + MIME.size() + 1;
+        if (!Fits(used)) return;
+
         size_t delim_pos = MIME.find('/');
         std::string type = delim_pos == std::string::npos ? ".undefined" : "." + MIME.substr(delim_pos + 1);
         std::ofstream logo(file + type, std::ios::binary);
-        size_t bytes_left = size - ENCODING_SIZE - price.size() - 1 - valid_until.size() - 1 -
-                            contact.size() - 1 - 1 - seller.size() - 1 - desc.size() - 1 - MIME.size() - 1;
+        size_t bytes_left = size - used;
         for (size_t i = 0; i < bytes_left; ++i) {
             char byte = in.get();
             logo.write(&byte, 1);
@@ -532,8 +885,8 @@ private:
         out << "Description: " << desc << '\n';
     }
 
-    char encoding;
-    char recieved_as;
+    char encoding = 0;
+    char recieved_as = 0;
     std::string price;
     std::string valid_until;
     std::string contact;
@@ -547,14 +900,15 @@ private:
 
 class ENCRFrame: public Frame {
 public:
-    ENCRFrame(std::ifstream& in) : Frame(in) {
+    ENCRFrame(std::istream& in) : Frame(in) {
         type = "ENCR Frame";
     }
 
 private:
-    void Read(std::ifstream& in) override {
+    void Read(std::istream& in) override {
         owner_id = ReadDataToZeroByte(in, 0x03);
         method = in.get();
+        if (!Fits(owner_id.size() + 1 + 1)) return;
         std::ofstream out("secret_data");
         for (size_t i = 0; i < size - owner_id.size() - 1 - 1; ++i) {
             char byte = in.get();
@@ -568,22 +922,23 @@ private:
     }
 
     std::string owner_id;
-    char method;
+    char method = 0;
 };
 
 
 class EQU2Frame: public Frame {
 public:
-    EQU2Frame(std::ifstream& in) : Frame(in) {
+    EQU2Frame(std::istream& in) : Frame(in) {
         type = "EQU2 Frame";
         freq = 0;
         volume = 0;
     }
 
 private:
-    void Read(std::ifstream& in) override {
+    void Read(std::istream& in) override {
         interpolation_method = in.get();
         id = ReadDataToZeroByte(in, 0x03);
+        if (!Fits(1 + id.size() + 1 + 2 + 2)) return;
         for (size_t i = 0; i < 2; ++i) {
             char byte = in.get();
             freq |= static_cast<unsigned char> (byte) << ((1 - i) * 8);
@@ -602,30 +957,30 @@ private:
 
     }
 
-    char interpolation_method;
+    char interpolation_method = 0;
     std::string id;
-    uint16_t freq;
-    uint16_t volume;
+    uint16_t freq = 0;
+    uint16_t volume = 0;
 };
 
 
 class LINKFrame: public Frame {
 public:
-    LINKFrame(std::ifstream& in) : Frame(in) {
+    LINKFrame(std::istream& in) : Frame(in) {
         type = "LINK Frame";
         id.resize(FRAME_ID_SIZE);
     }
 
 private:
-    void Read(std::ifstream& in) override {
-        std::cout << "Type: " << type << '\n';
+    void Read(std::istream& in) override {
         in.read(id.data(), id.size());
         url = ReadDataToZeroByte(in, 0x03);
         size_t cur_byte = id.size() + url.size() + 1;
-        while (cur_byte < size) {
+        while (cur_byte < size && in) {
             data.push_back(ReadDataToZeroByte(in, 0x03));
-            cur_byte += data.back().size();
+            cur_byte += data.back().size() + 1;
         }
+        Fits(cur_byte);
     }
 
     void Print(std::ostream& out) const override  {
@@ -647,18 +1002,23 @@ private:
 
 class OWNEFrame: public Frame {
 public:
-    OWNEFrame(std::ifstream& in) : Frame(in) {
+    OWNEFrame(std::istream& in) : Frame(in) {
         type = "OWNE Frame";
         date.resize(DATE_SIZE);
     }
 
+    int Encoding() const override {
+        return static_cast<unsigned char>(encoding);
+    }
+
 private:
-    void Read(std::ifstream& in) override {
-        encoding = in.get();
+    void Read(std::istream& in) override {
+        encoding = ReadEncoding(in);
         paid = ReadDataToZeroByte(in, encoding);
         in.read(date.data(), date.size());
+        if (!Fits(ENCODING_SIZE + paid.size() + 1 + date.size())) return;
         seller.resize(size - ENCODING_SIZE - paid.size() - 1 - date.size());
-        ReadData(encoding, in, seller);
+        if (!ReadData(encoding, in, seller)) error = ParseError::BAD_ENCODING;
     }
 
     void Print(std::ostream& out) const override  {
@@ -668,7 +1028,7 @@ private:
         std::cout << "Seller: " << seller << '\n';
     }
 
-    char encoding;
+    char encoding = 0;
     std::string paid;
     std::string date;
     std::string seller;
@@ -677,12 +1037,13 @@ private:
 
 class POSSFrame: public Frame {
 public:
-    POSSFrame(std::ifstream& in) : Frame(in) {
+    POSSFrame(std::istream& in) : Frame(in) {
         type = "POSS Frame";
     }
 
 private:
-    void Read(std::ifstream& in) override {
+    void Read(std::istream& in) override {
+        if (!Fits(1 + 4)) return;
         time_stamp_format = in.get();
         position = GetTime(in);
     }
@@ -693,19 +1054,20 @@ private:
         std::cout << "Position of something: " << position << '\n';
     }
 
-    char time_stamp_format;
-    uint32_t position;
+    char time_stamp_format = 0;
+    uint32_t position = 0;
 };
 
 
 class RBUFFrame: public Frame {
 public:
-    RBUFFrame(std::ifstream& in) : Frame(in) {
+    RBUFFrame(std::istream& in) : Frame(in) {
         type = "RBUF Frame";
     }
 
 private:
-    void Read(std::ifstream& in) override {
+    void Read(std::istream& in) override {
+        if (!Fits(4 + 1 + 4)) return;
         buffer_size = GetTime(in);
         char byte = in.get();
         embedded_info_flag = (bool)byte;
@@ -718,21 +1080,22 @@ private:
         std::cout << "Offset: " << offset << '\n';
     }
 
-    uint32_t buffer_size;
-    bool embedded_info_flag;
-    size_t offset;
+    uint32_t buffer_size = 0;
+    bool embedded_info_flag = false;
+    size_t offset = 0;
 };
 
 
 class RVA2Frame: public Frame {
 public:
-    RVA2Frame(std::ifstream& in) : Frame(in) {
+    RVA2Frame(std::istream& in) : Frame(in) {
         type = "RVA2 Frame";
         volume = 0;
     }
 
 private:
-    void Read(std::ifstream& in) override {
+    void Read(std::istream& in) override {
+        if (!Fits(1 + 2 + 1 + 4)) return;
         channel_type = in.get();
         for (size_t i = 0; i < 2; ++i) {
             char byte = in.get();
@@ -749,21 +1112,22 @@ private:
         std::cout << "Peak volume: " << peak_volume << '\n';
     }
 
-    char channel_type;
-    uint16_t volume;
-    char bits_representing_peak;
-    uint32_t peak_volume;
+    char channel_type = 0;
+    uint16_t volume = 0;
+    char bits_representing_peak = 0;
+    uint32_t peak_volume = 0;
 };
 
 
 class SEEKFrame: public Frame {
 public:
-    SEEKFrame(std::ifstream& in) : Frame(in) {
+    SEEKFrame(std::istream& in) : Frame(in) {
         type = "SEEK Frame";
     }
 
 private:
-    void Read(std::ifstream& in) override {
+    void Read(std::istream& in) override {
+        if (!Fits(4)) return;
         offset = GetTime(in);
     }
 
@@ -772,18 +1136,23 @@ private:
         std::cout << "Offset: " << offset << '\n';
     }
 
-    size_t offset;
+    size_t offset = 0;
 };
 
 class UFIDFrame: public Frame {
 public:
-    UFIDFrame(std::ifstream& in) : Frame(in) {
+    UFIDFrame(std::istream& in) : Frame(in) {
         type = "UFID Frame";
     }
 
+    void Fields(std::vector<FrameField>& fields) const override {
+        fields.push_back({owner_id, {}, {}});
+    }
+
 private:
-    void Read(std::ifstream& in) override {
+    void Read(std::istream& in) override {
         owner_id = ReadDataToZeroByte(in, 0x03);
+        if (!Fits(owner_id.size() + 1)) return;
         id.resize(size - owner_id.size() - 1);
         in.read(id.data(), id.size());
     }
@@ -801,14 +1170,15 @@ private:
 
 class USERFrame: public LanguageFrame {
 public:
-    USERFrame(std::ifstream& in) : LanguageFrame(in) {
+    USERFrame(std::istream& in) : LanguageFrame(in) {
         type = "USER Frame";
     }
 
 private:
-    void Read(std::ifstream& in) override {
-        encoding = in.get();
+    void Read(std::istream& in) override {
+        encoding = ReadEncoding(in);
         in.read(language.data(), language.size());
+        if (!Fits(ENCODING_SIZE + language.size())) return;
         data.resize(size - 1 - language.size());
         in.read(data.data(), data.size());
     }
@@ -819,4 +1189,231 @@ private:
         std::cout << "Language: " << language << '\n';
         std::cout << "Data: " << data << '\n';
     }
+};
+class APICFrame: public Frame {
+public:
+    APICFrame(std::istream& in) : Frame(in) {
+        type = "Attached Picture Frame";
+    }
+
+    void Fields(std::vector<FrameField>& fields) const override {
+        fields.push_back({mime, desc, {}});
+    }
+
+    int Encoding() const override {
+        return static_cast<unsigned char>(encoding);
+    }
+
+    const std::string& MimeType() const {
+        return mime;
+    }
+
+    uint8_t PictureType() const {
+        return picture_type;
+    }
+
+    // UTF-8 description
+    const std::string& Description() const {
+        return desc;
+    }
+
+    // The image is referenced by its place in the file, its bytes are never read
+    size_t ImageOffset() const {
+        return image_offset;
+    }
+
+    size_t ImageSize() const {
+        return image_size;
+    }
+
+private:
+    bool LoadsContent() const override {
+        return false;
+    }
+
+    void Read(std::istream& in) override {
+        size_t data_begin = in.tellg();
+        encoding = ReadEncoding(in);
+        mime = ReadToTerminator(in, 0x00);
+        picture_type = in.get();
+        desc = ReadToTerminator(in, encoding);
+
+        image_offset = in.tellg();
+        if (!in || !Fits(image_offset - data_begin)) return;
+        image_size = size - (image_offset - data_begin);
+        if (!DecodeText(encoding, desc)) {
+            error = ParseError::BAD_ENCODING;
+        }
+    }
+
+    void Print(std::ostream& out) const override  {
+        out << "This is: " << type << '\n';
+        out << "MIME type: " << mime << '\n';
+        out << "Picture type: " << PictureTypeToText(picture_type) << '\n';
+        out << "Description: " << desc << '\n';
+        out << "Image: " << image_size << " bytes at " << image_offset << '\n' << '\n';
+    }
+
+    char encoding = 0;
+    uint8_t picture_type = 0;
+    std::string mime;
+    std::string desc;
+    size_t image_offset = 0;
+    size_t image_size = 0;
+};
+
+// Frames with an element ID and embedded sub-frames (CHAP and CTOC)
+class ElementFrame: public Frame {
+public:
+    ElementFrame(std::istream& in, const std::string& file_) : Frame(in) {
+        file = file_;
+    }
+
+    void Fields(std::vector<FrameField>& fields) const override {
+        fields.push_back({element_id, {}, {}});
+    }
+
+    const std::string& ElementId() const {
+        return element_id;
+    }
+
+    const std::vector<std::unique_ptr<Frame>>& SubFrames() const {
+        return sub_frames;
+    }
+
+    // First sub-frame with the ID or nullptr
+    const Frame* SubFrame(const std::string& sub_id) const {
+        for (const auto& frame : sub_frames) {
+            if (frame->Id() == sub_id) {
+                return frame.get();
+            }
+        }
+        return nullptr;
+    }
+
+protected:
+    // Sub-frames are decoded against the budget one by one
+    bool LoadsContent() const override {
+        return false;
+    }
+
+    // Sub-frames fill the rest of the frame after `used` bytes
+    void ReadSubFrames(std::istream& in, size_t used) {
+        if (!in || !Fits(used)) return;
+        ParseError sub_error = ReadFrameRange(in, size - used, file, [&](std::unique_ptr<Frame>& frame) {
+            sub_frames.push_back(std::move(frame));
+        });
+        if (sub_error != ParseError::OK) {
+            error = sub_error;
+        }
+    }
+
+    void PrintSubFrames(std::ostream& out) const {
+        for (const auto& frame : sub_frames) {
+            out << *frame;
+        }
+    }
+
+    std::string element_id;
+    std::vector<std::unique_ptr<Frame>> sub_frames;
+    std::string file;
+};
+
+class CHAPFrame: public ElementFrame {
+public:
+    CHAPFrame(std::istream& in, const std::string& file_) : ElementFrame(in, file_) {
+        type = "Chapter Frame";
+    }
+
+    uint32_t StartTime() const {
+        return start_time;
+    }
+
+    uint32_t EndTime() const {
+        return end_time;
+    }
+
+    // NO_CHAPTER_OFFSET when the chapter is given by time only
+    uint32_t StartOffset() const {
+        return start_offset;
+    }
+
+    uint32_t EndOffset() const {
+        return end_offset;
+    }
+
+private:
+    void Read(std::istream& in) override {
+        size_t data_begin = in.tellg();
+        element_id = ReadToTerminator(in, 0x00);
+        start_time = GetTime(in);
+        end_time = GetTime(in);
+        start_offset = GetTime(in);
+        end_offset = GetTime(in);
+        ReadSubFrames(in, static_cast<size_t>(in.tellg()) - data_begin);
+    }
+
+    void Print(std::ostream& out) const override  {
+        out << "This is: " << type << '\n';
+        out << "Element ID: " << element_id << '\n';
+        out << "Time: " << start_time << " - " << end_time << " ms\n";
+        if (start_offset != NO_CHAPTER_OFFSET) {
+            out << "Offset: " << start_offset << " - " << end_offset << '\n';
+        }
+        PrintSubFrames(out);
+        out << '\n';
+    }
+
+    uint32_t start_time = 0;
+    uint32_t end_time = 0;
+    uint32_t start_offset = NO_CHAPTER_OFFSET;
+    uint32_t end_offset = NO_CHAPTER_OFFSET;
+};
+
+class CTOCFrame: public ElementFrame {
+public:
+    CTOCFrame(std::istream& in, const std::string& file_) : ElementFrame(in, file_) {
+        type = "Table of Contents Frame";
+    }
+
+    bool TopLevel() const {
+        return IsBitSet(toc_flags, 1);
+    }
+
+    bool Ordered() const {
+        return IsBitSet(toc_flags, 0);
+    }
+
+    // Element IDs of the CHAP and CTOC frames of this table
+    const std::vector<std::string>& Children() const {
+        return children;
+    }
+
+private:
+    void Read(std::istream& in) override {
+        size_t data_begin = in.tellg();
+        element_id = ReadToTerminator(in, 0x00);
+        toc_flags = in.get();
+        size_t entry_count = static_cast<unsigned char>(in.get());
+        for (size_t i = 0; i < entry_count && in; ++i) {
+            children.push_back(ReadToTerminator(in, 0x00));
+        }
+        ReadSubFrames(in, static_cast<size_t>(in.tellg()) - data_begin);
+    }
+
+    void Print(std::ostream& out) const override  {
+        out << "This is: " << type << '\n';
+        out << "Element ID: " << element_id << '\n';
+        out << "Top level: " << TopLevel() << ", ordered: " << Ordered() << '\n';
+        out << "Entries:";
+        for (const auto& child : children) {
+            out << ' ' << child;
+        }
+        out << '\n';
+        PrintSubFrames(out);
+        out << '\n';
+    }
+
+    char toc_flags = 0;
+    std::vector<std::string> children;
 };
\ No newline at end of file
@@ -0,0 +1,69 @@
+#include "probe.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+ParseError Probe(const std::string& file, bool check_end, ProbeResult& result) {
+    int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return result.error = ParseError::CANT_OPEN;
+    }
+
+    char data[HEADER_SIZE];
+    ssize_t length = pread(fd, data, sizeof(data), 0);
+    result.error = DecodeHeader(data, length < 0 ? 0 : length, result.header);
+
+    struct stat info;
+    if (fstat(fd, &info) == 0) {
+        result.file_size = info.st_size;
+        if (result.error == ParseError::OK && HEADER_SIZE + result.header.size > result.file_size) {
+            result.error = ParseError::TRUNCATED;
+        }
+    }
+
+    if (check_end) {
+        result.end_checked = true;
+
+        // An appended tag sits before ID3v1, so its footer is either last or 128 bytes earlier
+        char tail[ID3V1_SIZE + FOOTER_SIZE];
+        size_t tail_size = std::min(result.file_size, sizeof(tail));
+        length = pread(fd, tail, tail_size, result.file_size - tail_size);
+        if (length == static_cast<ssize_t>(tail_size)) {
+            const char* end = tail + tail_size;
+            if (tail_size >= ID3V1_SIZE && std::string(end - ID3V1_SIZE, HEADER_FILE_ID_SIZE) == "TAG") {
+                result.id3v1 = true;
+                end -= ID3V1_SIZE;
+            }
+
+            Header footer;
+            if (end - tail >= FOOTER_SIZE && std::string(end - FOOTER_SIZE, HEADER_FILE_ID_SIZE) == "3DI") {
+                std::string header(end - FOOTER_SIZE, FOOTER_SIZE);
+                header.replace(0, HEADER_FILE_ID_SIZE, "ID3");
+                if (DecodeHeader(header.data(), header.size(), footer) == ParseError::OK) {
+                    result.appended_tag = true;
+                    result.appended_size = footer.size;
+                }
+            }
+        }
+    }
+
+    close(fd);
+    return result.error;
+}
+
+std::ostream& operator<<(std::ostream& out, const ProbeResult& result) {
+    out << ErrorToText(result.error);
+    if (result.error == ParseError::OK || result.error == ParseError::TRUNCATED) {
+        const Header& header = result.header;
+        out << "\tv2." << static_cast<int>(header.version[0]) << '.' << static_cast<int>(header.version[1])
+            << "\tflags:" << (header.unsync ? 'u' : '-') << (header.ext_header ? 'x' : '-')
+            << (header.exp_ind ? 'e' : '-') << (header.footer ? 'f' : '-')
+            << "\tsize:" << header.size;
+    }
+    out << "\tfile:" << result.file_size;
+    if (result.end_checked) {
+        out << "\tid3v1:" << result.id3v1 << "\tappended:" << (result.appended_tag ? result.appended_size : 0);
+    }
+    return out;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "parser.h"
+#include <string>
+
+struct ProbeResult {
+    ParseError error = ParseError::OK;
+    Header header;
+    size_t file_size = 0;
+
+    // Filled only when the end of the file is probed
+    bool end_checked = false;
+    bool id3v1 = false;
+    bool appended_tag = false;
+    size_t appended_size = 0;
+};
+
+// Reads only the tag header (and with `check_end` the last 138 bytes, enough for
+// an ID3v1 tag and the footer of an appended tag) without decoding any frame.
+ParseError Probe(const std::string& file, bool check_end, ProbeResult& result);
+
+// One line: error, version, flags, declared tag size, file size and the end of file findings
+std::ostream& operator<<(std::ostream& out, const ProbeResult& result);
@@ -0,0 +1,145 @@
+#include "query_client.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+bool WriteAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        // A closed server fails the write instead of raising SIGPIPE
+        ssize_t length = send(fd, data, size, MSG_NOSIGNAL);
+        if (length <= 0) {
+            return false;
+        }
+        data += length;
+        size -= length;
+    }
+    return true;
+}
+
+bool ReadAll(int fd, char* data, size_t size) {
+    while (size > 0) {
+        ssize_t length = read(fd, data, size);
+        if (length <= 0) {
+            return false;
+        }
+        data += length;
+        size -= length;
+    }
+    return true;
+}
+
+double Percentile(const std::vector<double>& sorted, double fraction) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    return sorted[std::min(sorted.size() - 1, static_cast<size_t>(fraction * sorted.size()))];
+}
+
+}  // namespace
+
+QueryClient::~QueryClient() {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+bool QueryClient::Connect(const std::string& socket_path) {
+    sockaddr_un address{};
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    address.sun_family = AF_UNIX;
+    socket_path.copy(address.sun_path, socket_path.size());
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    return fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+}
+
+bool QueryClient::Query(QueryOp op, std::string_view payload, QueryStatus& status, std::string& body) {
+    std::string request = MakeMessage(static_cast<uint8_t>(op), payload);
+    if (!WriteAll(fd, request.data(), request.size())) {
+        return false;
+    }
+
+    char header[QUERY_HEADER_SIZE];
+    if (!ReadAll(fd, header, sizeof(header))) {
+        return false;
+    }
+
+    uint32_t length;
+    std::memcpy(&length, header, sizeof(length));
+    if (length == 0 || length > QUERY_MAX_MESSAGE) {
+        // The body is left unread, so the connection can't be used for another request
+        close(fd);
+        fd = -1;
+        return false;
+    }
+
+    status = static_cast<QueryStatus>(header[sizeof(length)]);
+    body.resize(length - 1);
+    return ReadAll(fd, body.data(), body.size());
+}
+
+LoadStats RunLoad(const std::string& socket_path, const std::vector<std::string>& paths,
+                  size_t connections, size_t requests) {
+    LoadStats stats;
+    if (paths.empty()) {
+        return stats;
+    }
+
+    std::vector<std::vector<double>> latencies(connections);
+    std::vector<size_t> failures(connections, 0);
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < connections; ++i) {
+        threads.emplace_back([&, i]() {
+            QueryClient client;
+            if (!client.Connect(socket_path)) {
+                failures[i] = requests;
+                return;
+            }
+
+            QueryStatus status;
+            std::string body;
+            latencies[i].reserve(requests);
+            for (size_t j = 0; j < requests; ++j) {
+                const std::string& path = paths[(i + j * connections) % paths.size()];
+                auto begin = std::chrono::steady_clock::now();
+                if (!client.Query(QueryOp::BY_PATH, path, status, body)) {
+                    failures[i] += requests - j;
+                    return;
+                }
+                auto end = std::chrono::steady_clock::now();
+                latencies[i].push_back(std::chrono::duration<double, std::micro>(end - begin).count());
+                if (status != QueryStatus::OK) {
+                    failures[i]++;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::vector<double> all;
+    for (size_t i = 0; i < connections; ++i) {
+        all.insert(all.end(), latencies[i].begin(), latencies[i].end());
+        stats.failures += failures[i];
+    }
+    std::sort(all.begin(), all.end());
+
+    stats.requests = all.size();
+    stats.p50_us = Percentile(all, 0.5);
+    stats.p90_us = Percentile(all, 0.9);
+    stats.p99_us = Percentile(all, 0.99);
+    stats.p999_us = Percentile(all, 0.999);
+    stats.max_us = all.empty() ? 0 : all.back();
+    return stats;
+}
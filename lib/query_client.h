@@ -0,0 +1,38 @@
+#pragma once
+#include "query_protocol.h"
+#include <string>
+#include <vector>
+
+// Blocking client for QueryServer
+class QueryClient {
+public:
+    QueryClient() = default;
+    QueryClient(const QueryClient&) = delete;
+    QueryClient& operator=(const QueryClient&) = delete;
+    ~QueryClient();
+
+    bool Connect(const std::string& socket_path);
+
+    // Sends one request and waits for its answer, false if the connection broke.
+    // An answer longer than QUERY_MAX_MESSAGE also fails and closes the connection.
+    bool Query(QueryOp op, std::string_view payload, QueryStatus& status, std::string& body);
+
+private:
+    int fd = -1;
+};
+
+struct LoadStats {
+    size_t requests = 0;
+    size_t failures = 0;
+    double seconds = 0;
+    double p50_us = 0;
+    double p90_us = 0;
+    double p99_us = 0;
+    double p999_us = 0;
+    double max_us = 0;
+};
+
+// Runs `connections` clients in parallel, each sending `requests` BY_PATH lookups
+// over `paths` round-robin, and reports latency percentiles
+LoadStats RunLoad(const std::string& socket_path, const std::vector<std::string>& paths,
+                  size_t connections, size_t requests);
@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+// Messages in both directions are <u32 length><u8 code><payload>, where length
+// counts the code and the payload. Integers are in host byte order since the
+// socket never leaves the machine.
+//
+// Requests:
+//   BY_PATH   payload is the file path
+//   BY_FRAME  payload is the frame ID
+//   BY_VALUE  payload is <string frame ID><string value>
+// Responses carry QueryStatus as the code. BY_PATH answers
+// <u32 ParseError><u32 count> and count times <string id><string key><string desc><string value>,
+// other requests answer <u32 count> and count times <string path>.
+// Strings are <u32 length><bytes>. An answer that wouldn't fit in QUERY_MAX_MESSAGE
+// keeps the fields or paths that fit and carries TRUNCATED instead of OK.
+
+const size_t QUERY_HEADER_SIZE = 5;
+const size_t QUERY_MAX_MESSAGE = 16 << 20;
+// Largest payload, the length also counts the code
+const size_t QUERY_MAX_PAYLOAD = QUERY_MAX_MESSAGE - 1;
+
+enum class QueryOp : uint8_t {
+    BY_PATH = 1,
+    BY_FRAME = 2,
+    BY_VALUE = 3
+};
+
+enum class QueryStatus : uint8_t {
+    OK = 0,
+    NOT_FOUND = 1,
+    BAD_REQUEST = 2,
+    TRUNCATED = 3
+};
+
+inline void PutU32(std::string& out, uint32_t value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+inline void PutString(std::string& out, std::string_view str) {
+    PutU32(out, static_cast<uint32_t>(str.size()));
+    out.append(str);
+}
+
+inline bool GetU32(std::string_view& in, uint32_t& value) {
+    if (in.size() < sizeof(value)) {
+        return false;
+    }
+    std::memcpy(&value, in.data(), sizeof(value));
+    in.remove_prefix(sizeof(value));
+    return true;
+}
+
+inline bool GetString(std::string_view& in, std::string_view& str) {
+    uint32_t size;
+    if (!GetU32(in, size) || in.size() < size) {
+        return false;
+    }
+    str = in.substr(0, size);
+    in.remove_prefix(size);
+    return true;
+}
+
+inline std::string MakeMessage(uint8_t code, std::string_view payload) {
+    std::string message;
+    message.reserve(QUERY_HEADER_SIZE + payload.size());
+    PutU32(message, static_cast<uint32_t>(payload.size() + 1));
+    message.push_back(static_cast<char>(code));
+    message.append(payload);
+    return message;
+}
@@ -0,0 +1,391 @@
+#include "query_server.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+const uint64_t LISTEN_ID = 0;
+const uint64_t EVENT_ID = 1;
+const size_t READ_SIZE = 64 * 1024;
+const int MAX_EVENTS = 256;
+
+// Writes the count of items put after `count_offset`, the caller reserved it
+void PatchCount(std::string& body, size_t count_offset, uint32_t count) {
+    std::memcpy(body.data() + count_offset, &count, sizeof(count));
+}
+
+// Paths that fit in one message, false if some were left out
+bool PutPaths(std::string& body, const std::vector<std::string>& paths) {
+    PutU32(body, 0);
+    uint32_t count = 0;
+    for (const auto& path : paths) {
+        if (body.size() + sizeof(uint32_t) + path.size() > QUERY_MAX_PAYLOAD) {
+            break;
+        }
+        PutString(body, path);
+        ++count;
+    }
+    PatchCount(body, 0, count);
+    return count == paths.size();
+}
+
+}  // namespace
+
+std::string HandleQuery(const LibraryIndex& index, QueryOp op, std::string_view payload) {
+    std::string body;
+    bool complete = true;
+    switch (op) {
+        case QueryOp::BY_PATH: {
+            IndexEntry entry;
+            std::shared_ptr<const StringPool> pool;
+            if (!index.Find(std::string(payload), entry, pool)) {
+                return MakeMessage(static_cast<uint8_t>(QueryStatus::NOT_FOUND), body);
+            }
+
+            PutU32(body, static_cast<uint32_t>(entry.error));
+            PutU32(body, 0);
+            uint32_t count = 0;
+            for (const auto& field : entry.fields) {
+                std::string_view strings[] = {pool->View(field.frame_id), pool->View(field.key),
+                                              pool->View(field.desc), pool->View(field.value)};
+                size_t size = 0;
+                for (auto str : strings) {
+                    size += sizeof(uint32_t) + str.size();
+                }
+                if (body.size() + size > QUERY_MAX_PAYLOAD) {
+                    complete = false;
+                    break;
+                }
+                for (auto str : strings) {
+                    PutString(body, str);
+                }
+                ++count;
+            }
+            PatchCount(body, sizeof(uint32_t), count);
+            break;
+        }
+        case QueryOp::BY_FRAME:
+            complete = PutPaths(body, index.FindByFrame(std::string(payload)));
+            break;
+        case QueryOp::BY_VALUE: {
+            std::string_view frame_id;
+            std::string_view value;
+            if (!GetString(payload, frame_id) || !GetString(payload, value)) {
+                return MakeMessage(static_cast<uint8_t>(QueryStatus::BAD_REQUEST), body);
+            }
+            complete = PutPaths(body, index.FindByValue(std::string(frame_id), std::string(value)));
+            break;
+        }
+        default:
+            return MakeMessage(static_cast<uint8_t>(QueryStatus::BAD_REQUEST), body);
+    }
+
+    QueryStatus status = complete ? QueryStatus::OK : QueryStatus::TRUNCATED;
+    return MakeMessage(static_cast<uint8_t>(status), body);
+}
+
+QueryServer::QueryServer(const LibraryIndex& index_, size_t workers_count)
+    : index(index_), listen_fd(-1), running(false), next_connection(EVENT_ID + 1) {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    workers.resize(std::max<size_t>(1, workers_count));
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = EVENT_ID;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, event_fd, &event);
+}
+
+QueryServer::~QueryServer() {
+    for (auto& [id, connection] : connections) {
+        if (!connection.closed) {
+            close(connection.fd);
+        }
+    }
+    if (listen_fd >= 0) {
+        close(listen_fd);
+        unlink(socket_path.c_str());
+    }
+    close(event_fd);
+    close(epoll_fd);
+}
+
+bool QueryServer::Listen(const std::string& path) {
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    address.sun_family = AF_UNIX;
+    path.copy(address.sun_path, path.size());
+
+    // A socket left by an earlier server is replaced, any other file is never removed
+    struct stat info;
+    if (lstat(path.c_str(), &info) == 0) {
+        if (!S_ISSOCK(info.st_mode)) {
+            return false;
+        }
+        unlink(path.c_str());
+    }
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        return false;
+    }
+
+    if (bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+        listen(listen_fd, SOMAXCONN) < 0) {
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+    socket_path = path;
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = LISTEN_ID;
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event) == 0;
+}
+
+void QueryServer::Run() {
+    running = true;
+    for (auto& worker : workers) {
+        worker = std::thread(&QueryServer::Work, this);
+    }
+
+    epoll_event events[MAX_EVENTS];
+    while (running) {
+        int count = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+        for (int i = 0; i < count; ++i) {
+            uint64_t id = events[i].data.u64;
+            if (id == LISTEN_ID) {
+                Accept();
+            } else if (id == EVENT_ID) {
+                uint64_t value;
+                while (read(event_fd, &value, sizeof(value)) > 0) {}
+                Complete();
+            } else if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+                // Both directions are gone, nothing can be answered any more
+                Close(id);
+            } else {
+                if (events[i].events & EPOLLIN) {
+                    ReadFrom(id);
+                }
+                if (events[i].events & EPOLLOUT) {
+                    WriteTo(id);
+                }
+            }
+        }
+    }
+
+    {
+        // Workers check `running` under the lock, so none of them can miss the wake up
+        std::lock_guard lock(mutex);
+    }
+    has_jobs.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void QueryServer::Stop() {
+    running = false;
+    Wake();
+}
+
+void QueryServer::Accept() {
+    int fd;
+    while ((fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        uint64_t id = next_connection++;
+        Connection& connection = connections[id];
+        connection.fd = fd;
+        connection.events = EPOLLIN;
+
+        epoll_event event{};
+        event.events = connection.events;
+        event.data.u64 = id;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+void QueryServer::ReadFrom(uint64_t id) {
+    auto it = connections.find(id);
+    if (it == connections.end() || it->second.closed) {
+        return;
+    }
+
+    // Reading stops at one request of the largest size, Dispatch resumes it once the request is taken
+    Connection& connection = it->second;
+    char buffer[READ_SIZE];
+    while (!connection.eof && connection.in.size() < QUERY_MAX_BUFFER) {
+        ssize_t length = read(connection.fd, buffer, std::min(sizeof(buffer), QUERY_MAX_BUFFER - connection.in.size()));
+        if (length > 0) {
+            connection.in.append(buffer, length);
+        } else if (length == 0) {
+            connection.eof = true;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        } else {
+            Close(id);
+            return;
+        }
+    }
+
+    Dispatch(id);
+}
+
+void QueryServer::WriteTo(uint64_t id) {
+    auto it = connections.find(id);
+    if (it == connections.end() || it->second.closed) {
+        return;
+    }
+
+    Connection& connection = it->second;
+    while (connection.out_pos < connection.out.size()) {
+        // A client gone before its answer must not kill the server with SIGPIPE
+        ssize_t length = send(connection.fd, connection.out.data() + connection.out_pos,
+                              connection.out.size() - connection.out_pos, MSG_NOSIGNAL);
+        if (length < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                Close(id);
+                return;
+            }
+            break;
+        }
+        connection.out_pos += length;
+    }
+
+    if (connection.out_pos == connection.out.size()) {
+        connection.out.clear();
+        connection.out_pos = 0;
+    }
+    Dispatch(id);
+}
+
+void QueryServer::Dispatch(uint64_t id) {
+    auto it = connections.find(id);
+    if (it == connections.end()) {
+        return;
+    }
+
+    Connection& connection = it->second;
+    if (connection.closed) {
+        return;
+    }
+
+    uint32_t length;
+    if (!connection.busy && connection.in.size() >= sizeof(length)) {
+        std::memcpy(&length, connection.in.data(), sizeof(length));
+        if (length == 0 || length > QUERY_MAX_MESSAGE) {
+            Close(id);
+            return;
+        }
+        if (connection.in.size() >= sizeof(length) + length) {
+            connection.busy = true;
+            {
+                std::lock_guard lock(mutex);
+                jobs.push_back({id, connection.in.substr(sizeof(length), length)});
+            }
+            connection.in.erase(0, sizeof(length) + length);
+            has_jobs.notify_one();
+        }
+    }
+
+    // A client that shut down its side still gets the answers to its complete requests
+    if (connection.eof && !connection.busy && connection.out.empty()) {
+        Close(id);
+        return;
+    }
+
+    uint32_t events = 0;
+    if (!connection.eof && connection.in.size() < QUERY_MAX_BUFFER) {
+        events |= EPOLLIN;
+    }
+    if (!connection.out.empty()) {
+        events |= EPOLLOUT;
+    }
+    if (events != connection.events) {
+        connection.events = events;
+        epoll_event event{};
+        event.events = events;
+        event.data.u64 = id;
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, connection.fd, &event);
+    }
+}
+
+void QueryServer::Complete() {
+    std::deque<Job> finished;
+    {
+        std::lock_guard lock(mutex);
+        finished.swap(done);
+    }
+
+    for (auto& job : finished) {
+        auto it = connections.find(job.connection);
+        if (it == connections.end()) {
+            continue;
+        }
+        if (it->second.closed) {
+            connections.erase(it);
+            continue;
+        }
+
+        it->second.busy = false;
+        it->second.out += job.request;
+        WriteTo(job.connection);
+    }
+}
+
+void QueryServer::Close(uint64_t id) {
+    auto it = connections.find(id);
+    if (it == connections.end() || it->second.closed) {
+        return;
+    }
+
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, it->second.fd, nullptr);
+    close(it->second.fd);
+    // A worker may still hold a request of this connection, the entry goes away with its answer
+    if (it->second.busy) {
+        it->second.closed = true;
+    } else {
+        connections.erase(it);
+    }
+}
+
+void QueryServer::Wake() {
+    uint64_t value = 1;
+    write(event_fd, &value, sizeof(value));
+}
+
+void QueryServer::Work() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock lock(mutex);
+            has_jobs.wait(lock, [this]() {
+                return !jobs.empty() || !running;
+            });
+            if (!running) {
+                return;
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        std::string_view request = job.request;
+        QueryOp op = static_cast<QueryOp>(request[0]);
+        request.remove_prefix(1);
+        job.request = HandleQuery(index, op, request);
+
+        {
+            std::lock_guard lock(mutex);
+            done.push_back(std::move(job));
+        }
+        Wake();
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include "library_index.h"
+#include "query_protocol.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+const size_t QUERY_WORKERS = 4;
+// Unanswered input kept per connection, enough for one request of the largest size
+const size_t QUERY_MAX_BUFFER = sizeof(uint32_t) + QUERY_MAX_MESSAGE;
+
+// Answers a single request payload, used by the server workers
+std::string HandleQuery(const LibraryIndex& index, QueryOp op, std::string_view payload);
+
+// Serves LibraryIndex lookups over a Unix domain socket. One thread runs the epoll
+// loop and owns all connections, lookups run on a pool of workers. Requests of one
+// connection are answered in order, one at a time; a connection stops being read while
+// QUERY_MAX_BUFFER bytes of its input wait.
+class QueryServer {
+public:
+    QueryServer(const LibraryIndex& index, size_t workers = QUERY_WORKERS);
+    ~QueryServer();
+
+    bool Listen(const std::string& socket_path);
+
+    // Serves clients until Stop() is called from another thread
+    void Run();
+
+    void Stop();
+
+private:
+    struct Connection {
+        int fd;
+        std::string in;
+        std::string out;
+        size_t out_pos = 0;
+        uint32_t events = 0;  // current epoll interest
+        bool busy = false;
+        bool eof = false;
+        bool closed = false;
+    };
+
+    struct Job {
+        uint64_t connection;
+        std::string request;
+    };
+
+    void Accept();
+    void ReadFrom(uint64_t id);
+    void WriteTo(uint64_t id);
+    void Dispatch(uint64_t id);
+    void Complete();
+    void Close(uint64_t id);
+    void Wake();
+    void Work();
+
+    const LibraryIndex& index;
+    std::string socket_path;
+    int listen_fd;
+    int epoll_fd;
+    int event_fd;
+    std::atomic<bool> running;
+    uint64_t next_connection;
+    std::unordered_map<uint64_t, Connection> connections;
+
+    std::mutex mutex;
+    std::condition_variable has_jobs;
+    std::deque<Job> jobs;
+    std::deque<Job> done;
+    std::vector<std::thread> workers;
+};
@@ -0,0 +1,95 @@
+#include "string_pool.h"
+#include <mutex>
+#include <stdexcept>
+
+StringPool::StringPool(size_t shards_count) : shard_bits(0) {
+    while ((static_cast<size_t>(1) << shard_bits) < shards_count) {
+        shard_bits++;
+    }
+
+    for (size_t i = 0; i < (static_cast<size_t>(1) << shard_bits); ++i) {
+        shards.push_back(std::make_unique<Shard>());
+    }
+}
+
+bool StringPool::Find(std::string_view str, uint32_t& id) const {
+    if (str.empty()) {
+        id = 0;
+        return true;
+    }
+
+    size_t shard_id = std::hash<std::string_view>{}(str) & ((static_cast<size_t>(1) << shard_bits) - 1);
+    const Shard& shard = *shards[shard_id];
+    std::shared_lock lock(shard.mutex);
+    auto it = shard.ids.find(str);
+    if (it == shard.ids.end()) {
+        return false;
+    }
+
+    id = it->second;
+    return true;
+}
+
+uint32_t StringPool::Intern(std::string_view str) {
+    if (str.empty()) {
+        return 0;
+    }
+
+    size_t shard_id = std::hash<std::string_view>{}(str) & ((static_cast<size_t>(1) << shard_bits) - 1);
+    Shard& shard = *shards[shard_id];
+    {
+        std::shared_lock lock(shard.mutex);
+        auto it = shard.ids.find(str);
+        if (it != shard.ids.end()) {
+            return it->second;
+        }
+    }
+
+    std::unique_lock lock(shard.mutex);
+    auto it = shard.ids.find(str);
+    if (it != shard.ids.end()) {
+        return it->second;
+    }
+
+    // The index is stored above the shard bits, it must not be truncated into another string's id
+    if (shard.strings.size() + 1 > (UINT32_MAX >> shard_bits)) {
+        throw std::length_error("StringPool: out of 32-bit ids");
+    }
+
+    // Elements of a deque never move, so the map can key on views into them
+    shard.strings.emplace_back(str);
+    shard.bytes += str.size();
+    uint32_t id = static_cast<uint32_t>((shard.strings.size() << shard_bits) | shard_id);
+    shard.ids.emplace(shard.strings.back(), id);
+    return id;
+}
+
+std::string_view StringPool::View(uint32_t id) const {
+    if (id == 0) {
+        return {};
+    }
+
+    const Shard& shard = *shards[id & ((1u << shard_bits) - 1)];
+    std::shared_lock lock(shard.mutex);
+    return shard.strings[(id >> shard_bits) - 1];
+}
+
+size_t StringPool::Size() const {
+    size_t size = 0;
+    for (const auto& shard : shards) {
+        std::shared_lock lock(shard->mutex);
+        size += shard->strings.size();
+    }
+
+    return size;
+}
+
+size_t StringPool::Bytes() const {
+    size_t bytes = 0;
+    for (const auto& shard : shards) {
+        std::shared_lock lock(shard->mutex);
+        bytes += shard->bytes;
+    }
+
+    return bytes;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+const size_t STRING_POOL_SHARDS = 16;
+
+// Thread-safe pool of unique strings. Every distinct string is stored once and gets
+// a stable 32-bit id; views returned by the pool stay valid for its whole lifetime.
+// Id 0 is reserved for the empty string. Like a full container, Intern throws
+// std::length_error once a shard runs out of ids (about 2^32 / shards strings each).
+class StringPool {
+public:
+    explicit StringPool(size_t shards = STRING_POOL_SHARDS);
+
+    uint32_t Intern(std::string_view str);
+
+    std::string_view View(uint32_t id) const;
+
+    // Looks the string up without adding it
+    bool Find(std::string_view str, uint32_t& id) const;
+
+    // Number of unique strings and total bytes they occupy
+    size_t Size() const;
+    size_t Bytes() const;
+
+private:
+    struct Shard {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<std::string_view, uint32_t> ids;
+        std::deque<std::string> strings;
+        size_t bytes = 0;
+    };
+
+    size_t shard_bits;
+    std::vector<std::unique_ptr<Shard>> shards;
+};
@@ -0,0 +1,124 @@
+#include "strip.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// Shares extents with the source, only possible for block-aligned ranges
+bool CloneRange(int src_fd, int dst_fd, size_t begin, size_t end, size_t file_size, size_t block_size) {
+    if (block_size == 0 || begin % block_size != 0 || (end != file_size && (end - begin) % block_size != 0)) {
+        return false;
+    }
+
+    file_clone_range range{};
+    range.src_fd = src_fd;
+    range.src_offset = begin;
+    range.src_length = end - begin;
+    range.dest_offset = 0;
+    return ioctl(dst_fd, FICLONERANGE, &range) == 0;
+}
+
+// Advances `begin` over everything the kernel managed to copy
+void CopyInKernel(int src_fd, int dst_fd, size_t& begin, size_t end) {
+    while (begin < end) {
+        loff_t src_offset = begin;
+        ssize_t copied = copy_file_range(src_fd, &src_offset, dst_fd, nullptr, end - begin, 0);
+        if (copied <= 0) {
+            return;
+        }
+        begin += copied;
+    }
+}
+
+bool CopyBlocks(int src_fd, int dst_fd, size_t begin, size_t end) {
+    void* memory = nullptr;
+    if (posix_memalign(&memory, 4096, COPY_BLOCK_SIZE) != 0) {
+        return false;
+    }
+    char* buffer = static_cast<char*>(memory);
+
+    bool ok = true;
+    while (ok && begin < end) {
+        ssize_t length = pread(src_fd, buffer, std::min(COPY_BLOCK_SIZE, end - begin), begin);
+        if (length <= 0) {
+            ok = false;
+            break;
+        }
+        begin += length;
+
+        for (ssize_t written = 0; written < length;) {
+            ssize_t count = write(dst_fd, buffer + written, length - written);
+            if (count <= 0) {
+                ok = false;
+                break;
+            }
+            written += count;
+        }
+    }
+
+    free(buffer);
+    return ok;
+}
+
+}  // namespace
+
+ParseError StripTag(const std::string& src, const std::string& dst, bool strip_trailer) {
+    AudioRange range;
+    {
+        std::ifstream in(src, std::ios::binary);
+        if (!in.is_open()) {
+            return ParseError::CANT_OPEN;
+        }
+        range = GetAudioRange(in);
+    }
+    if (range.error != ParseError::OK) {
+        return range.error;
+    }
+
+    int src_fd = open(src.c_str(), O_RDONLY | O_CLOEXEC);
+    if (src_fd < 0) {
+        return ParseError::CANT_OPEN;
+    }
+
+    struct stat info;
+    if (fstat(src_fd, &info) != 0 || range.begin > static_cast<size_t>(info.st_size)) {
+        close(src_fd);
+        return ParseError::TRUNCATED;
+    }
+    size_t file_size = info.st_size;
+    size_t end = strip_trailer ? range.end : file_size;
+
+    // Truncating the destination would destroy the source when both are the same file
+    struct stat dst_info;
+    if (stat(dst.c_str(), &dst_info) == 0 && dst_info.st_dev == info.st_dev && dst_info.st_ino == info.st_ino) {
+        close(src_fd);
+        return ParseError::WRITE_FAILED;
+    }
+
+    int dst_fd = open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, info.st_mode & 0777);
+    if (dst_fd < 0) {
+        close(src_fd);
+        return ParseError::WRITE_FAILED;
+    }
+
+    size_t begin = range.begin;
+    bool ok = CloneRange(src_fd, dst_fd, begin, end, file_size, info.st_blksize);
+    if (!ok) {
+        // copy_file_range may stop half way (e.g. EXDEV on old kernels), the rest goes through userspace
+        CopyInKernel(src_fd, dst_fd, begin, end);
+        ok = begin == end || (lseek(dst_fd, begin - range.begin, SEEK_SET) >= 0 && CopyBlocks(src_fd, dst_fd, begin, end));
+    }
+
+    close(src_fd);
+    if (close(dst_fd) != 0 || !ok) {
+        unlink(dst.c_str());
+        return ParseError::WRITE_FAILED;
+    }
+    return ParseError::OK;
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include "parser.h"
+#include <string>
+
+const size_t COPY_BLOCK_SIZE = 1 << 20;
+
+// Writes a copy of `src` without its leading ID3v2 tag. With `strip_trailer` the
+// appended ID3v2 tag and ID3v1 tag are dropped too, leaving only the audio payload.
+// Data is copied inside the kernel (reflink or copy_file_range) where possible.
+// A leading tag that can't be decoded fails with its error, `dst` naming `src` with WRITE_FAILED.
+ParseError StripTag(const std::string& src, const std::string& dst, bool strip_trailer);
+
+inline ParseError ExtractAudio(const std::string& src, const std::string& dst) {
+    return StripTag(src, dst, true);
+}
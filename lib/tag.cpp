@@ -0,0 +1,171 @@
+#include "tag.h"
+#include <algorithm>
+#include <tuple>
+
+namespace {
+
+const uint64_t HASH_MULTIPLIER = 0x9E3779B97F4A7C15ULL;
+
+size_t HashId(uint32_t id) {
+    return (id * HASH_MULTIPLIER) >> 16;
+}
+
+size_t HashField(uint32_t id, std::string_view key, std::string_view desc) {
+    std::hash<std::string_view> hash;
+    return HashId(id) ^ (hash(key) * HASH_MULTIPLIER) ^ hash(desc);
+}
+
+// At least twice the number of keys, so probe sequences stay short
+size_t TableSize(size_t keys) {
+    size_t size = 8;
+    while (size < keys * 2) {
+        size <<= 1;
+    }
+    return size;
+}
+
+// Leading number of a text value, false if there is none or it doesn't fit in 32 bits
+bool LeadingNumber(std::string_view value, uint32_t& number) {
+    uint64_t result = 0;
+    bool found = false;
+    for (char chr : value) {
+        if (chr < '0' || chr > '9') {
+            break;
+        }
+        result = result * 10 + (chr - '0');
+        if (result > UINT32_MAX) {
+            return false;
+        }
+        found = true;
+    }
+    if (found) {
+        number = result;
+    }
+    return found;
+}
+
+}  // namespace
+
+Tag::Range Tag::GetAll(std::string_view frame_id) const {
+    uint32_t id = PackFrameId(frame_id);
+    return Lookup(id_slots, HashId(id), id, nullptr, nullptr);
+}
+
+Tag::Range Tag::GetAll(std::string_view frame_id, std::string_view key, std::string_view desc) const {
+    uint32_t id = PackFrameId(frame_id);
+    return Lookup(field_slots, HashField(id, key, desc), id, &key, &desc);
+}
+
+Tag::Range Tag::Lookup(const std::vector<Slot>& slots, size_t hash, uint32_t id, const std::string_view* key,
+                       const std::string_view* desc) const {
+    if (slots.empty()) {
+        return {nullptr, nullptr};
+    }
+
+    size_t mask = slots.size() - 1;
+    for (size_t i = hash & mask; slots[i].first != 0; i = (i + 1) & mask) {
+        const TagEntry& entry = entries[slots[i].first - 1];
+        if (entry.id == id && (key == nullptr || (entry.key == *key && entry.desc == *desc))) {
+            return {entries.data() + slots[i].first - 1, entries.data() + slots[i].last};
+        }
+    }
+    return {nullptr, nullptr};
+}
+
+void Tag::BuildIndex() {
+    std::stable_sort(entries.begin(), entries.end(), [](const TagEntry& lhs, const TagEntry& rhs) {
+        return std::tie(lhs.id, lhs.key, lhs.desc) < std::tie(rhs.id, rhs.key, rhs.desc);
+    });
+
+    size_t ids = 0;
+    size_t fields = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (i == 0 || entries[i].id != entries[i - 1].id) {
+            ++ids;
+        }
+        if (i == 0 || std::tie(entries[i].id, entries[i].key, entries[i].desc) !=
+                      std::tie(entries[i - 1].id, entries[i - 1].key, entries[i - 1].desc)) {
+            ++fields;
+        }
+    }
+    id_slots.assign(TableSize(ids), Slot());
+    field_slots.assign(TableSize(fields), Slot());
+
+    auto insert = [](std::vector<Slot>& slots, size_t hash, uint32_t first, uint32_t last) {
+        size_t mask = slots.size() - 1;
+        size_t i = hash & mask;
+        while (slots[i].first != 0) {
+            i = (i + 1) & mask;
+        }
+        slots[i] = {first + 1, last};
+    };
+
+    // Runs of equal keys are adjacent after sorting, each run takes one slot
+    for (size_t first = 0; first < entries.size();) {
+        size_t last = first;
+        while (last < entries.size() && entries[last].id == entries[first].id) {
+            ++last;
+        }
+        insert(id_slots, HashId(entries[first].id), first, last);
+        first = last;
+    }
+    for (size_t first = 0; first < entries.size();) {
+        const TagEntry& entry = entries[first];
+        size_t last = first;
+        while (last < entries.size() && entries[last].id == entry.id && entries[last].key == entry.key &&
+               entries[last].desc == entry.desc) {
+            ++last;
+        }
+        insert(field_slots, HashField(entry.id, entry.key, entry.desc), first, last);
+        first = last;
+    }
+}
+
+bool Tag::Track(uint32_t& track) const {
+    return LeadingNumber(Get("TRCK"), track);
+}
+
+bool Tag::Year(uint32_t& year) const {
+    return LeadingNumber(Get("TDRC"), year) || LeadingNumber(Get("TYER"), year);
+}
+
+bool Tag::Rating(uint8_t& rating) const {
+    const Frame* frame = GetFrame("POPM");
+    if (frame == nullptr) {
+        return false;
+    }
+    rating = static_cast<const PopularimeterFrame*>(frame)->Rating();
+    return true;
+}
+
+bool Tag::PlayCount(uint64_t& count) const {
+    if (const Frame* frame = GetFrame("PCNT")) {
+        count = static_cast<const PlayCounterFrame*>(frame)->Counter();
+        return true;
+    }
+    if (const Frame* frame = GetFrame("POPM")) {
+        count = static_cast<const PopularimeterFrame*>(frame)->Counter();
+        return true;
+    }
+    return false;
+}
+
+ParseError ReadTag(const std::string& file, Tag& tag) {
+    tag = Tag();
+    std::vector<FrameField> fields;
+    ParseError error = TakeFrames(file, tag.header, [&](std::unique_ptr<Frame>& frame) {
+        uint32_t id = PackFrameId(frame->Id());
+        fields.clear();
+        frame->Fields(fields);
+        if (fields.empty()) {
+            tag.entries.push_back({id, {}, {}, {}, frame.get()});
+        }
+        for (const auto& field : fields) {
+            tag.entries.push_back({id, field.key, field.desc, field.value, frame.get()});
+        }
+        tag.frames.push_back(std::move(frame));
+    });
+
+    tag.BuildIndex();
+    return error;
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include "parser.h"
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Four characters of a frame ID packed big-endian, 0 for anything else
+inline uint32_t PackFrameId(std::string_view frame_id) {
+    if (frame_id.size() != FRAME_ID_SIZE) {
+        return 0;
+    }
+    uint32_t id = 0;
+    for (char chr : frame_id) {
+        id = id << 8 | static_cast<unsigned char>(chr);
+    }
+    return id;
+}
+
+// One text field of a frame, see Frame::Fields. Views point into the frame, which the tag owns.
+// Frames without text get one entry with empty views, so every frame is in the index.
+struct TagEntry {
+    uint32_t id;
+    std::string_view key;
+    std::string_view desc;
+    std::string_view value;
+    const Frame* frame;
+};
+
+// Decoded tag of a file. The index is flat: fields of all frames live in one array
+// sorted by (frame ID, key, description) with tag order kept among equal keys, so
+// all values of a key are adjacent. Two open-addressing tables map a frame ID and
+// a full (frame ID, key, description) to their range of the array. The frames the
+// fields point into are still allocated one by one.
+class Tag {
+public:
+    using Range = std::pair<const TagEntry*, const TagEntry*>;
+
+    const Header& GetHeader() const {
+        return header;
+    }
+
+    size_t Size() const {
+        return entries.size();
+    }
+
+    const TagEntry* begin() const {
+        return entries.data();
+    }
+
+    const TagEntry* end() const {
+        return entries.data() + entries.size();
+    }
+
+    // All fields of the frame ID: every value of a text frame, every TXXX, every COMM.
+    // Fields are ordered by key and description, in tag order among equal ones.
+    Range GetAll(std::string_view frame_id) const;
+
+    // Fields with the key (language of COMM/USLT, email of POPM, owner of PRIV/UFID)
+    // and the description (of TXXX, COMM, APIC). Empty parts match empty fields only.
+    Range GetAll(std::string_view frame_id, std::string_view key, std::string_view desc) const;
+
+    // First value of the frame ID, empty if there is none
+    std::string_view Get(std::string_view frame_id) const {
+        Range range = GetAll(frame_id);
+        return range.first == range.second ? std::string_view() : range.first->value;
+    }
+
+    // TXXX by its description
+    std::string_view GetUserText(std::string_view desc) const {
+        Range range = GetAll("TXXX", {}, desc);
+        return range.first == range.second ? std::string_view() : range.first->value;
+    }
+
+    // COMM by its language and description
+    std::string_view GetComment(std::string_view language, std::string_view desc) const {
+        Range range = GetAll("COMM", language, desc);
+        return range.first == range.second ? std::string_view() : range.first->value;
+    }
+
+    // Frame of the first field with the ID, nullptr if there is none
+    const Frame* GetFrame(std::string_view frame_id) const {
+        Range range = GetAll(frame_id);
+        return range.first == range.second ? nullptr : range.first->frame;
+    }
+
+    // Typed accessors return false when the tag has no such value or it doesn't fit.
+    // Track number of TRCK ("3/12" gives 3)
+    bool Track(uint32_t& track) const;
+    // Year of TDRC, or of TYER in v2.3 tags
+    bool Year(uint32_t& year) const;
+    // Rating of the first POPM by email
+    bool Rating(uint8_t& rating) const;
+    // PCNT counter, or the counter of the first POPM by email
+    bool PlayCount(uint64_t& count) const;
+
+private:
+    friend ParseError ReadTag(const std::string& file, Tag& tag);
+
+    struct Slot {
+        uint32_t first = 0;  // index + 1, 0 is an empty slot
+        uint32_t last = 0;
+    };
+
+    void BuildIndex();
+    Range Lookup(const std::vector<Slot>& slots, size_t hash, uint32_t id, const std::string_view* key,
+                 const std::string_view* desc) const;
+
+    Header header;
+    std::vector<std::unique_ptr<Frame>> frames;
+    std::vector<TagEntry> entries;
+    std::vector<Slot> id_slots;
+    std::vector<Slot> field_slots;
+};
+
+// Decodes the whole tag of the file. A tag that fails to parse keeps the frames decoded before the error.
+ParseError ReadTag(const std::string& file, Tag& tag);
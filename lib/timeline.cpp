@@ -0,0 +1,120 @@
+#include "timeline.h"
+#include <algorithm>
+#include <numeric>
+
+namespace {
+
+const size_t MPEG_SYNC_SEARCH = 4096;
+const uint32_t SAMPLE_RATES[4][3] = {
+    {11025, 12000, 8000},   // MPEG 2.5
+    {0, 0, 0},              // reserved
+    {22050, 24000, 16000},  // MPEG 2
+    {44100, 48000, 32000},  // MPEG 1
+};
+
+template <typename T>
+std::vector<size_t> SortedOrder(const std::vector<T>& data, uint32_t T::* time) {
+    std::vector<size_t> order(data.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) {
+        return data[lhs].*time < data[rhs].*time;
+    });
+    return order;
+}
+
+}  // namespace
+
+double MpegFrameDuration(std::istream& in, const AudioRange& range) {
+    std::string buffer(std::min(MPEG_SYNC_SEARCH, range.end - range.begin), '\0');
+    in.clear();
+    in.seekg(range.begin, std::ios::beg);
+    in.read(buffer.data(), buffer.size());
+    buffer.resize(in.gcount());
+    in.clear();
+
+    for (size_t i = 0; i + 4 <= buffer.size(); ++i) {
+        unsigned char b1 = buffer[i + 1];
+        unsigned char b2 = buffer[i + 2];
+        if (static_cast<unsigned char>(buffer[i]) != 0xFF || (b1 & 0xE0) != 0xE0) {
+            continue;
+        }
+
+        size_t version = (b1 >> 3) & 0x03;
+        size_t layer = (b1 >> 1) & 0x03;
+        size_t rate_index = (b2 >> 2) & 0x03;
+        if (version == 1 || layer == 0 || rate_index == 3) {
+            continue;
+        }
+
+        // Layer bits: 3 is Layer I, 2 is Layer II, 1 is Layer III
+        double samples = layer == 3 ? 384 : (layer == 2 || version == 3 ? 1152 : 576);
+        return samples * 1000.0 / SAMPLE_RATES[version][rate_index];
+    }
+
+    return DEFAULT_MPEG_FRAME_MS;
+}
+
+Timeline::Timeline(const SYLTFrame& frame, double mpeg_frame_ms) : lyrics(true) {
+    const auto& data = frame.Lyrics();
+    std::vector<size_t> order = SortedOrder(data, &std::pair<uint32_t, std::string>::first);
+
+    times.reserve(data.size());
+    text_offsets.reserve(data.size() + 1);
+    for (size_t i : order) {
+        times.push_back(ToMilliseconds(data[i].first, frame.TimeStampFormat(), mpeg_frame_ms));
+        text_offsets.push_back(text.size());
+        text += data[i].second;
+    }
+    text_offsets.push_back(text.size());
+}
+
+Timeline::Timeline(const ETCOFrame& frame, double mpeg_frame_ms) : lyrics(false) {
+    const auto& data = frame.Events();
+    std::vector<size_t> order = SortedOrder(data, &std::pair<char, uint32_t>::second);
+
+    times.reserve(data.size());
+    events.reserve(data.size());
+    for (size_t i : order) {
+        times.push_back(ToMilliseconds(data[i].second, frame.TimeStampFormat(), mpeg_frame_ms));
+        events.push_back(data[i].first);
+    }
+    text_offsets.assign(data.size() + 1, 0);
+}
+
+size_t Timeline::At(uint32_t ms) const {
+    auto it = std::upper_bound(times.begin(), times.end(), ms);
+    return it == times.begin() ? NONE : it - times.begin() - 1;
+}
+
+std::pair<size_t, size_t> Timeline::Next(uint32_t ms, size_t count) const {
+    size_t first = std::upper_bound(times.begin(), times.end(), ms) - times.begin();
+    return {first, first + std::min(count, times.size() - first)};
+}
+
+uint32_t Timeline::ToMilliseconds(uint32_t time, char format, double mpeg_frame_ms) {
+    if (format == TIME_STAMP_MPEG_FRAMES) {
+        // Converting a double out of the range of uint32_t is undefined
+        double ms = time * mpeg_frame_ms + 0.5;
+        return ms >= UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(ms);
+    }
+    return time;
+}
+
+ParseError ReadTimelines(const std::string& file, std::vector<Timeline>& timelines) {
+    double mpeg_frame_ms = DEFAULT_MPEG_FRAME_MS;
+    {
+        std::ifstream in(file, std::ios::binary);
+        if (in.is_open()) {
+            mpeg_frame_ms = MpegFrameDuration(in, GetAudioRange(in));
+        }
+    }
+
+    Header header;
+    return ParseFrames(file, header, [&](Frame& frame) {
+        if (frame.Id() == "SYLT") {
+            timelines.emplace_back(static_cast<const SYLTFrame&>(frame), mpeg_frame_ms);
+        } else if (frame.Id() == "ETCO") {
+            timelines.emplace_back(static_cast<const ETCOFrame&>(frame), mpeg_frame_ms);
+        }
+    });
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include "parser.h"
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+const char TIME_STAMP_MPEG_FRAMES = 0x01;
+const char TIME_STAMP_MILLISECONDS = 0x02;
+
+// 1152 samples per frame at 44.1 kHz, used when the audio doesn't tell otherwise
+const double DEFAULT_MPEG_FRAME_MS = 1152 * 1000.0 / 44100;
+
+// Duration of one MPEG audio frame in milliseconds, read from the first frame header
+// of the audio payload. Returns DEFAULT_MPEG_FRAME_MS if there is no valid header.
+double MpegFrameDuration(std::istream& in, const AudioRange& range);
+
+// Sorted timeline of a SYLT or ETCO frame with timestamps in milliseconds.
+// Timestamps, text offsets and event types are kept in separate arrays
+// so lookups only touch the timestamp column.
+class Timeline {
+public:
+    static const size_t NONE = static_cast<size_t>(-1);
+
+    Timeline(const SYLTFrame& frame, double mpeg_frame_ms = DEFAULT_MPEG_FRAME_MS);
+    Timeline(const ETCOFrame& frame, double mpeg_frame_ms = DEFAULT_MPEG_FRAME_MS);
+
+    bool IsLyrics() const {
+        return lyrics;
+    }
+
+    size_t Size() const {
+        return times.size();
+    }
+
+    uint32_t Time(size_t i) const {
+        return times[i];
+    }
+
+    std::string_view Text(size_t i) const {
+        return std::string_view(text).substr(text_offsets[i], text_offsets[i + 1] - text_offsets[i]);
+    }
+
+    char Event(size_t i) const {
+        return events[i];
+    }
+
+    // Entry active at `ms`: the last one starting at or before it, NONE before the first one
+    size_t At(uint32_t ms) const;
+
+    // Range [first, last) of at most `count` entries starting strictly after `ms`
+    std::pair<size_t, size_t> Next(uint32_t ms, size_t count) const;
+
+private:
+    static uint32_t ToMilliseconds(uint32_t time, char format, double mpeg_frame_ms);
+
+    bool lyrics;
+    std::vector<uint32_t> times;
+    std::vector<uint32_t> text_offsets;
+    std::string text;
+    std::vector<char> events;
+};
+
+// Builds timelines of all SYLT and ETCO frames of the file
+ParseError ReadTimelines(const std::string& file, std::vector<Timeline>& timelines);
@@ -0,0 +1,174 @@
+#include "watcher.h"
+#include <algorithm>
+#include <filesystem>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace {
+
+const uint32_t WATCH_MASK = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                            IN_DELETE_SELF | IN_ONLYDIR;
+const size_t EVENT_BUFFER_SIZE = 64 * 1024;
+
+}  // namespace
+
+LibraryWatcher::LibraryWatcher(LibraryIndex& index_, std::chrono::milliseconds debounce_)
+    : index(index_), debounce(debounce_), running(false) {
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+}
+
+LibraryWatcher::~LibraryWatcher() {
+    if (inotify_fd >= 0) {
+        close(inotify_fd);
+    }
+}
+
+bool LibraryWatcher::AddDirectory(const std::string& dir) {
+    std::error_code error;
+    if (inotify_fd < 0 || !std::filesystem::is_directory(dir, error)) {
+        return false;
+    }
+
+    roots.push_back(dir);
+    WatchTree(dir);
+    Flush();
+    return true;
+}
+
+void LibraryWatcher::Run() {
+    using std::chrono::steady_clock;
+
+    running = true;
+    while (running) {
+        std::chrono::milliseconds timeout = debounce;
+        if (!pending.empty()) {
+            auto deadline = std::min(last_change + debounce, first_change + WATCH_MAX_DELAY);
+            timeout = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - steady_clock::now());
+            timeout = std::max(timeout, std::chrono::milliseconds(0));
+        }
+
+        pollfd fd{inotify_fd, POLLIN, 0};
+        if (poll(&fd, 1, static_cast<int>(timeout.count())) > 0) {
+            HandleEvents();
+        }
+
+        auto now = steady_clock::now();
+        if (!pending.empty() && (now - last_change >= debounce || now - first_change >= WATCH_MAX_DELAY)) {
+            Flush();
+        }
+    }
+
+    Flush();
+}
+
+void LibraryWatcher::Stop() {
+    running = false;
+}
+
+void LibraryWatcher::WatchTree(const std::string& dir) {
+    int wd = inotify_add_watch(inotify_fd, dir.c_str(), WATCH_MASK);
+    if (wd < 0) {
+        return;
+    }
+    watches[wd] = dir;
+
+    // Files created before the watch was added are picked up by the scan
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(dir, error)) {
+        if (entry.is_directory(error) && !entry.is_symlink(error)) {
+            WatchTree(entry.path().string());
+        } else if (entry.is_regular_file(error)) {
+            pending[entry.path().string()] = Change::UPDATED;
+        }
+    }
+
+    if (!pending.empty()) {
+        last_change = std::chrono::steady_clock::now();
+    }
+}
+
+void LibraryWatcher::HandleEvents() {
+    alignas(inotify_event) char buffer[EVENT_BUFFER_SIZE];
+    ssize_t length;
+    while ((length = read(inotify_fd, buffer, sizeof(buffer))) > 0) {
+        for (char* ptr = buffer; ptr < buffer + length;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(ptr);
+            ptr += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                Rescan();
+                continue;
+            }
+            if (event->mask & (IN_IGNORED | IN_DELETE_SELF)) {
+                watches.erase(event->wd);
+                continue;
+            }
+
+            auto it = watches.find(event->wd);
+            if (it == watches.end() || event->len == 0) {
+                continue;
+            }
+
+            if (pending.empty()) {
+                first_change = std::chrono::steady_clock::now();
+            }
+            last_change = std::chrono::steady_clock::now();
+
+            std::string path = it->second + '/' + event->name;
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    WatchTree(path);
+                } else if (event->mask & IN_MOVED_FROM) {
+                    // Directory moved out of the library keeps its watches, drop them
+                    std::string prefix = path + '/';
+                    for (auto watch = watches.begin(); watch != watches.end();) {
+                        if (watch->second == path || watch->second.compare(0, prefix.size(), prefix) == 0) {
+                            inotify_rm_watch(inotify_fd, watch->first);
+                            watch = watches.erase(watch);
+                        } else {
+                            ++watch;
+                        }
+                    }
+                    index.RemoveDirectory(path);
+                } else if (event->mask & IN_DELETE) {
+                    index.RemoveDirectory(path);
+                }
+            } else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE)) {
+                // A hard link only gets IN_CREATE, a file still being written is parsed again on IN_CLOSE_WRITE
+                pending[path] = Change::UPDATED;
+            } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                pending[path] = Change::REMOVED;
+            }
+        }
+    }
+}
+
+void LibraryWatcher::Flush() {
+    for (const auto& [path, change] : pending) {
+        if (change == Change::UPDATED) {
+            index.Update(path);
+        } else {
+            index.Remove(path);
+        }
+    }
+    pending.clear();
+}
+
+void LibraryWatcher::Rescan() {
+    // Events were lost, so every file under the roots has to be checked again. Entries are
+    // replaced one by one and only files that are gone are removed, queries never see an empty library.
+    for (const auto& [wd, dir] : watches) {
+        inotify_rm_watch(inotify_fd, wd);
+    }
+    watches.clear();
+    pending.clear();
+
+    for (const auto& root : roots) {
+        WatchTree(root);
+        for (auto& path : index.PathsUnder(root)) {
+            pending.emplace(std::move(path), Change::REMOVED);
+        }
+    }
+    first_change = std::chrono::steady_clock::now();
+}
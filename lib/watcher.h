@@ -0,0 +1,48 @@
+#pragma once
+#include "library_index.h"
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+const std::chrono::milliseconds WATCH_DEBOUNCE(500);
+const std::chrono::milliseconds WATCH_MAX_DELAY(5000);
+
+// Keeps LibraryIndex in sync with directories using inotify.
+// Changes are collected until the directories are quiet for `debounce`
+// (or for at most WATCH_MAX_DELAY) and then only the changed files are re-parsed.
+class LibraryWatcher {
+public:
+    LibraryWatcher(LibraryIndex& index, std::chrono::milliseconds debounce = WATCH_DEBOUNCE);
+    ~LibraryWatcher();
+
+    // Watches the directory recursively and indexes files it already has
+    bool AddDirectory(const std::string& dir);
+
+    // Processes events until Stop() is called from another thread
+    void Run();
+
+    void Stop();
+
+private:
+    enum class Change {
+        UPDATED,
+        REMOVED
+    };
+
+    void WatchTree(const std::string& dir);
+    void HandleEvents();
+    void Flush();
+    void Rescan();
+
+    LibraryIndex& index;
+    std::chrono::milliseconds debounce;
+    int inotify_fd;
+    std::atomic<bool> running;
+    std::vector<std::string> roots;
+    std::unordered_map<int, std::string> watches;
+    std::unordered_map<std::string, Change> pending;
+    std::chrono::steady_clock::time_point first_change;
+    std::chrono::steady_clock::time_point last_change;
+};
@@ -0,0 +1,125 @@
+/* Built as C against the shared library, so the header and the exported ABI are checked together */
+#include "id3parse.h"
+#include <stdio.h>
+#include <string.h>
+
+static int failures = 0;
+
+#define CHECK(condition)                                                                   \
+    do {                                                                                   \
+        if (!(condition)) {                                                                \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition);  \
+            ++failures;                                                                    \
+        }                                                                                  \
+    } while (0)
+
+struct frames {
+    size_t count;
+    char ids[4][5];
+    size_t sizes[4];
+    size_t stop_after;
+};
+
+static int collect(const char* id, uint16_t flags, const unsigned char* data, size_t size, void* user) {
+    struct frames* frames = (struct frames*)user;
+    (void)flags;
+    (void)data;
+    if (frames->count < 4) {
+        memcpy(frames->ids[frames->count], id, 4);
+        frames->ids[frames->count][4] = '\0';
+        frames->sizes[frames->count] = size;
+    }
+    ++frames->count;
+    return frames->count == frames->stop_after;
+}
+
+/* Appends a frame with a size in the format of the major version */
+static size_t put_frame(unsigned char* out, int version, const char* id, size_t size, unsigned char fill) {
+    memcpy(out, id, 4);
+    if (version == 3) {
+        out[4] = (unsigned char)(size >> 24);
+        out[5] = (unsigned char)(size >> 16);
+        out[6] = (unsigned char)(size >> 8);
+        out[7] = (unsigned char)size;
+    } else {
+        out[4] = (unsigned char)(size >> 21 & 0x7F);
+        out[5] = (unsigned char)(size >> 14 & 0x7F);
+        out[6] = (unsigned char)(size >> 7 & 0x7F);
+        out[7] = (unsigned char)(size & 0x7F);
+    }
+    out[8] = 0;
+    out[9] = 0;
+    memset(out + 10, fill, size);
+    return 10 + size;
+}
+
+static size_t put_tag(unsigned char* tag, int version, size_t frames_size) {
+    memcpy(tag, "ID3", 3);
+    tag[3] = (unsigned char)version;
+    tag[4] = 0;
+    tag[5] = 0;
+    tag[6] = (unsigned char)(frames_size >> 21 & 0x7F);
+    tag[7] = (unsigned char)(frames_size >> 14 & 0x7F);
+    tag[8] = (unsigned char)(frames_size >> 7 & 0x7F);
+    tag[9] = (unsigned char)(frames_size & 0x7F);
+    return 10 + frames_size;
+}
+
+int main(void) {
+    static unsigned char tag[4096];
+    id3_parser* parser = id3_parser_new();
+    struct frames frames;
+    size_t used;
+
+    CHECK(id3_parser_frames(parser, collect, &frames) == ID3_NOT_OPEN);
+
+    /* v2.4: three frames and padding */
+    used = 10;
+    used += put_frame(tag + used, 4, "TIT2", 6, 'a');
+    used += put_frame(tag + used, 4, "APIC", 300, 'b');
+    used += put_frame(tag + used, 4, "TPE1", 1, 'c');
+    memset(tag + used, 0, 20);
+    used = put_tag(tag, 4, used - 10 + 20);
+
+    CHECK(id3_parser_open_memory(parser, tag, used) == ID3_OK);
+    CHECK(id3_parser_version(parser) == 0x0400);
+    CHECK(id3_parser_tag_size(parser) == used - 10);
+
+    memset(&frames, 0, sizeof(frames));
+    CHECK(id3_parser_frames(parser, collect, &frames) == ID3_OK);
+    CHECK(frames.count == 3);
+    CHECK(strcmp(frames.ids[0], "TIT2") == 0 && frames.sizes[0] == 6);
+    CHECK(strcmp(frames.ids[1], "APIC") == 0 && frames.sizes[1] == 300);
+    CHECK(strcmp(frames.ids[2], "TPE1") == 0 && frames.sizes[2] == 1);
+
+    /* A non-zero return stops the iteration */
+    memset(&frames, 0, sizeof(frames));
+    frames.stop_after = 2;
+    CHECK(id3_parser_frames(parser, collect, &frames) == ID3_OK);
+    CHECK(frames.count == 2);
+
+    /* v2.4 frame size with a byte that isn't synchsafe */
+    tag[10 + 6] |= 0x80;
+    CHECK(id3_parser_open_memory(parser, tag, used) == ID3_OK);
+    CHECK(id3_parser_frames(parser, collect, &frames) == ID3_BAD_SIZE);
+
+    /* v2.3 frame sizes are plain 32-bit, 200 bytes has the high bit of the low byte set */
+    used = 10;
+    used += put_frame(tag + used, 3, "APIC", 200, 'd');
+    used += put_frame(tag + used, 3, "TIT2", 4, 'e');
+    used = put_tag(tag, 3, used - 10);
+
+    memset(&frames, 0, sizeof(frames));
+    CHECK(id3_parser_open_memory(parser, tag, used) == ID3_OK);
+    CHECK(id3_parser_version(parser) == 0x0300);
+    CHECK(id3_parser_frames(parser, collect, &frames) == ID3_OK);
+    CHECK(frames.count == 2 && frames.sizes[0] == 200 && frames.sizes[1] == 4);
+
+    /* A tag larger than the buffer */
+    CHECK(id3_parser_open_memory(parser, tag, used - 1) == ID3_TRUNCATED);
+    CHECK(id3_parser_version(parser) == 0);
+    CHECK(strlen(id3_error_text(ID3_BAD_SIZE)) > 0);
+
+    id3_parser_free(parser);
+    return failures;
+}
@@ -0,0 +1,36 @@
+#include "crc32.h"
+#include "test_util.h"
+#include <random>
+#include <string>
+
+int main() {
+    // Check value of the CRC-32 catalogue
+    std::string digits = "123456789";
+    CHECK(Crc32(digits.data(), digits.size()) == 0xCBF43926);
+    CHECK(Crc32Portable(digits.data(), digits.size()) == 0xCBF43926);
+    CHECK(Crc32(nullptr, 0) == 0);
+
+    std::string fox = "The quick brown fox jumps over the lazy dog";
+    CHECK(Crc32(fox.data(), fox.size()) == 0x414FA339);
+
+    // The fast path starts at 64 bytes and folds 16-byte blocks, cover the edges and unaligned starts
+    std::mt19937 random(1);
+    std::string data(4096 + 64, '\0');
+    for (auto& chr : data) {
+        chr = static_cast<char>(random());
+    }
+    for (size_t offset = 0; offset < 16; ++offset) {
+        for (size_t size : {0, 1, 15, 16, 17, 63, 64, 65, 79, 80, 127, 128, 129, 1000, 4096}) {
+            CHECK(Crc32(data.data() + offset, size) == Crc32Portable(data.data() + offset, size));
+        }
+    }
+
+    // Chained over any split, as TakeFrames does chunk by chunk
+    uint32_t whole = Crc32Portable(data.data(), data.size());
+    for (size_t split : {0, 1, 64, 100, 2048, 4159}) {
+        uint32_t crc = Crc32(data.data(), split);
+        CHECK(Crc32(data.data() + split, data.size() - split, crc) == whole);
+    }
+
+    return Failures();
+}
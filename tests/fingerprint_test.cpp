@@ -0,0 +1,36 @@
+#include "fingerprint.h"
+#include "test_util.h"
+#include <string>
+
+int main() {
+    // Reference values of XXH64 with seed 0, whose layout HashBytes follows
+    CHECK(HashBytes("", 0, 0) == 0xEF46DB3751D8E999ULL);
+    CHECK(HashBytes("a", 1, 0) == 0xD24EC4F1A98C6E5BULL);
+    CHECK(HashBytes("abc", 3, 0) == 0x44BC2CF5AD770999ULL);
+    std::string stripes = "Nobody inspects the spammish repetition";
+    CHECK(HashBytes(stripes.data(), stripes.size(), 0) == 0xFBCEA83C8A378BF1ULL);
+    CHECK(HashBytes("abc", 3, 1) != HashBytes("abc", 3, 0));
+
+    // Same audio under different tags, spread over several chunks
+    std::string audio(2 * FINGERPRINT_CHUNK_SIZE + 123, '\0');
+    for (size_t i = 0; i < audio.size(); ++i) {
+        audio[i] = static_cast<char>(i * 31 + i / 7);
+    }
+    std::string first = WriteTemp("fingerprint_1.mp3", MakeTag(0x04, MakeFrame(0x04, "TIT2", std::string("\0A", 2))) + audio);
+    std::string second = WriteTemp("fingerprint_2.mp3", MakeTag(0x04, MakeFrame(0x04, "TIT2", std::string("\0Longer", 7))) + audio);
+    std::string empty = WriteTemp("fingerprint_empty.mp3", "");
+
+    AudioFingerprint one_thread = FingerprintAudio(first, 1);
+    AudioFingerprint four_threads = FingerprintAudio(first, 4);
+    CHECK(one_thread.valid && one_thread.size == audio.size());
+    CHECK(one_thread == four_threads);
+    CHECK(FingerprintAudio(second, 3) == one_thread);
+
+    AudioFingerprint missing = FingerprintAudio(empty + ".missing", 1);
+    CHECK(!missing.valid && missing.error == ParseError::CANT_OPEN);
+    CHECK(!FingerprintAudio(empty, 1).valid);
+
+    auto duplicates = FindDuplicates({first, empty, second}, 2);
+    CHECK(duplicates.size() == 1 && duplicates[0].size() == 2);
+    return Failures();
+}
@@ -0,0 +1,75 @@
+#include "query_protocol.h"
+#include "query_server.h"
+#include "test_util.h"
+#include <string>
+
+namespace {
+
+// Splits a message into its code and payload, false if the length doesn't match
+bool Decode(const std::string& message, uint8_t& code, std::string_view& payload) {
+    std::string_view in = message;
+    uint32_t length;
+    if (!GetU32(in, length) || length == 0 || length != in.size()) {
+        return false;
+    }
+    code = static_cast<uint8_t>(in[0]);
+    payload = in.substr(1);
+    return true;
+}
+
+}  // namespace
+
+int main() {
+    std::string payload;
+    PutString(payload, "TPE1");
+    PutString(payload, std::string("with\0zero", 9));
+    PutU32(payload, 0xDEADBEEF);
+
+    std::string message = MakeMessage(static_cast<uint8_t>(QueryOp::BY_VALUE), payload);
+    CHECK(message.size() == QUERY_HEADER_SIZE + payload.size());
+
+    uint8_t code;
+    std::string_view in;
+    CHECK(Decode(message, code, in));
+    CHECK(code == static_cast<uint8_t>(QueryOp::BY_VALUE));
+
+    std::string_view frame_id;
+    std::string_view value;
+    uint32_t number;
+    CHECK(GetString(in, frame_id) && frame_id == "TPE1");
+    CHECK(GetString(in, value) && value == std::string_view("with\0zero", 9));
+    CHECK(GetU32(in, number) && number == 0xDEADBEEF);
+    CHECK(in.empty());
+
+    // A string longer than the rest of the input fails
+    std::string_view cut = std::string_view(payload).substr(0, 6);
+    CHECK(!GetString(cut, value));
+    CHECK(!GetU32(cut, number));
+
+    // Server side of the same messages
+    LibraryIndex index;
+    std::string answer = HandleQuery(index, QueryOp::BY_VALUE, payload.substr(0, 7));
+    CHECK(Decode(answer, code, in) && code == static_cast<uint8_t>(QueryStatus::BAD_REQUEST));
+
+    answer = HandleQuery(index, QueryOp::BY_PATH, "/no/such/file.mp3");
+    CHECK(Decode(answer, code, in) && code == static_cast<uint8_t>(QueryStatus::NOT_FOUND));
+
+    std::string file = WriteTemp("query.mp3", MakeTag(0x04, MakeFrame(0x04, "TPE1", std::string("\0Artist", 7))));
+    index.Update(file);
+    answer = HandleQuery(index, QueryOp::BY_FRAME, "TPE1");
+    std::string_view path;
+    CHECK(Decode(answer, code, in) && code == static_cast<uint8_t>(QueryStatus::OK));
+    CHECK(GetU32(in, number) && number == 1);
+    CHECK(GetString(in, path) && path == file && in.empty());
+
+    answer = HandleQuery(index, QueryOp::BY_PATH, file);
+    std::string_view strings[4];
+    CHECK(Decode(answer, code, in) && code == static_cast<uint8_t>(QueryStatus::OK));
+    CHECK(GetU32(in, number) && number == static_cast<uint32_t>(ParseError::OK));
+    CHECK(GetU32(in, number) && number == 1);
+    for (auto& str : strings) {
+        CHECK(GetString(in, str));
+    }
+    CHECK(strings[0] == "TPE1" && strings[3] == "Artist" && in.empty());
+    return Failures();
+}
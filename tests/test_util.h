@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+// Failed checks are printed and counted, main returns the count
+inline int& Failures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition)                                                                   \
+    do {                                                                                   \
+        if (!(condition)) {                                                                \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            ++Failures();                                                                  \
+        }                                                                                  \
+    } while (0)
+
+inline std::string Synchsafe(size_t size) {
+    return {static_cast<char>(size >> 21 & 0x7F), static_cast<char>(size >> 14 & 0x7F),
+            static_cast<char>(size >> 7 & 0x7F), static_cast<char>(size & 0x7F)};
+}
+
+inline std::string BigEndian(uint32_t value) {
+    return {static_cast<char>(value >> 24), static_cast<char>(value >> 16), static_cast<char>(value >> 8),
+            static_cast<char>(value)};
+}
+
+// Frame with a size in the format of the major version, no flags
+inline std::string MakeFrame(char version, const std::string& frame_id, const std::string& content) {
+    std::string size = version == 0x03 ? BigEndian(content.size()) : Synchsafe(content.size());
+    return frame_id + size + std::string(2, '\0') + content;
+}
+
+// Tag without extended header around the frames
+inline std::string MakeTag(char version, const std::string& frames) {
+    return std::string("ID3") + version + std::string(2, '\0') + Synchsafe(frames.size()) + frames;
+}
+
+// Writes the data to a file in the temporary directory and returns its path
+inline std::string WriteTemp(const std::string& name, const std::string& data) {
+    std::string path = (std::filesystem::temp_directory_path() / ("id3parse_test_" + name)).string();
+    std::ofstream(path, std::ios::binary) << data;
+    return path;
+}
@@ -0,0 +1,53 @@
+#include "tag.h"
+#include "test_util.h"
+#include <string>
+
+namespace {
+
+std::string Bytes(const char* data, size_t size) {
+    return std::string(data, size);
+}
+
+// "hi" in UTF-16 with a little-endian BOM and its terminator
+const std::string HI_LE = Bytes("\xFF\xFEh\0i\0\0\0", 8);
+
+}  // namespace
+
+int main() {
+    std::string frames;
+    // UTF-16 with an empty description, its terminator is only the BOM away from the text
+    frames += MakeFrame(0x04, "COMM", Bytes("\x01" "eng" "\xFF\xFE\0\0", 8) + HI_LE);
+    // ISO-8859-1 text keeps no terminator and is converted to UTF-8
+    frames += MakeFrame(0x04, "COMM", Bytes("\x00" "fra" "d\xE9sc\0" "hello\0", 15));
+    // Big-endian BOM
+    frames += MakeFrame(0x04, "COMM", Bytes("\x01" "deu" "\xFE\xFF\0x\0\0" "\xFE\xFF\0y", 14));
+    // $02 is big-endian without BOM
+    frames += MakeFrame(0x04, "USLT", Bytes("\x02" "eng" "\0d\0\0" "\0l\0a", 12));
+    frames += MakeFrame(0x04, "TXXX", Bytes("\x01" "\xFF\xFEk\0e\0y\0\0\0", 11) + HI_LE);
+    frames += MakeFrame(0x04, "TRCK", Bytes("\x01" "\xFF\xFE" "7\0/\0" "9\0", 9));
+
+    Tag tag;
+    CHECK(ReadTag(WriteTemp("text_frames.mp3", MakeTag(0x04, frames)), tag) == ParseError::OK);
+    CHECK(tag.GetComment("eng", "") == "hi");
+    CHECK(tag.GetComment("fra", "d\xC3\xA9sc") == "hello");
+    CHECK(tag.GetComment("deu", "x") == "y");
+    CHECK(tag.GetAll("USLT", "eng", "d").first != nullptr);
+    CHECK(tag.GetAll("USLT", "eng", "d").first->value == "la");
+    CHECK(tag.GetUserText("key") == "hi");
+    uint32_t track = 0;
+    CHECK(tag.Track(track) && track == 7);
+
+    // A lone surrogate isn't valid UTF-16
+    std::string broken = MakeFrame(0x04, "TIT2", Bytes("\x01" "\xFF\xFE\x00\xD8", 5));
+    CHECK(ReadTag(WriteTemp("broken_text.mp3", MakeTag(0x04, broken)), tag) == ParseError::BAD_ENCODING);
+
+    // v2.3 frame sizes aren't synchsafe: 200 = 0xC8 has the high bit of its low byte set
+    std::string picture = Bytes("\0image/png\0\x03\0", 13) + std::string(200, '\x5A');
+    std::string v23 = MakeFrame(0x03, "APIC", picture) + MakeFrame(0x03, "TXXX", Bytes("\0k\0", 3) + std::string(300, 'v')) +
+                      MakeFrame(0x03, "TIT2", Bytes("\0Title", 6));
+    CHECK(ReadTag(WriteTemp("v23.mp3", MakeTag(0x03, v23)), tag) == ParseError::OK);
+    CHECK(tag.GetFrame("APIC") != nullptr && tag.GetFrame("APIC")->ContentSize() == picture.size());
+    CHECK(tag.GetUserText("k") == std::string(300, 'v'));
+    CHECK(tag.Get("TIT2") == "Title");
+    return Failures();
+}